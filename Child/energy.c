@@ -0,0 +1,69 @@
+
+/*! \file energy.c
+    \brief Time spent per power state, for the battery-life model
+*/
+
+#include "common.h"
+#include "energy.h"
+
+#ifdef ENERGY_ACCOUNTING
+
+volatile u32_t energyTicks[ENERGY_STATES];
+
+static u16_t energySince[ENERGY_STATES];
+static u8_t energyOn = 0;                    /* bit per state */
+
+/*!
+ \brief Enter state, safe from ISRs, no effect if already in it
+ */
+void EnergyStart(u8_t state)
+{
+  __istate_t istate = __get_interrupt_state();
+
+  __disable_interrupt();
+  if (!(energyOn & (1 << state)))
+  {
+    energySince[state] = TAR;
+    energyOn |= (1 << state);
+  }
+  __set_interrupt_state(istate);
+}
+
+/*!
+ \brief Leave state, safe from ISRs, no effect if not in it
+ */
+void EnergyStop(u8_t state)
+{
+  __istate_t istate = __get_interrupt_state();
+
+  __disable_interrupt();
+  if (energyOn & (1 << state))
+  {
+    energyTicks[state] += (u16_t)(TAR - energySince[state]);
+    energyOn &= ~(1 << state);
+  }
+  __set_interrupt_state(istate);
+}
+
+/*!
+ \brief Fold running states into energyTicks[]
+
+ Call from the TimerA0 ISR, at least once per TAR wrap, so that no
+ interval is longer than 16 bits.
+ */
+void EnergyTick(void)
+{
+  u16_t now = TAR;
+  u8_t state;
+
+  for (state = 0; state < ENERGY_STATES; state++)
+  {
+    if (energyOn & (1 << state))
+    {
+      energyTicks[state] += (u16_t)(now - energySince[state]);
+      energySince[state] = now;
+    }
+  }
+}
+
+#endif
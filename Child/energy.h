@@ -0,0 +1,37 @@
+#ifndef _ENERGY_H_
+#define _ENERGY_H_
+
+#include "common.h"
+
+/*
+  Energy accounting. Time spent in each state is counted in TimerA ticks
+  (SMCLK/8, 8us) into energyTicks[], read them with the debugger or the
+  simulator. States overlap: ENERGY_CPU is the MCU awake, LPM is the
+  rest; ENERGY_RADIO_ON is PWR_UP, Standby is what TX and RX leave of it.
+  Off by default, the hooks then cost nothing.
+*/
+#define ENERGY_CPU            (0)   /* MCU active, not in LPM */
+#define ENERGY_ADC_REF        (1)   /* ADC10 with REFON */
+#define ENERGY_BEEP           (2)   /* piezo driven by Beep() */
+#define ENERGY_RADIO_ON       (3)   /* nRF24L01 PWR_UP */
+#define ENERGY_RADIO_TX       (4)   /* PTX, CE pulse to TX_DS/MAX_RT */
+#define ENERGY_RADIO_RX       (5)   /* PRX with CE high */
+#define ENERGY_STATES         (6)
+
+#ifdef ENERGY_ACCOUNTING
+
+extern volatile u32_t energyTicks[ENERGY_STATES];
+
+void EnergyStart(u8_t state);
+void EnergyStop(u8_t state);
+void EnergyTick(void);
+
+#else
+
+#define EnergyStart(state)    ((void)0)
+#define EnergyStop(state)     ((void)0)
+#define EnergyTick()          ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+
+/*! \file event.c
+    \brief Event dispatcher, ISRs post and main runs the handlers
+*/
+
+#include "common.h"
+#include "event.h"
+#include "energy.h"
+#include "probe.h"
+
+static volatile u16_t eventPending = 0;
+
+/*!
+ \brief Mark an event pending, safe from ISRs
+
+ The posting ISR must still leave low power mode on exit
+ (__low_power_mode_off_on_exit()) for the loop to run the handler.
+ */
+void EventPost(u8_t event)
+{
+  __istate_t state = __get_interrupt_state();
+  
+  __disable_interrupt();
+  eventPending |= (1U << event);
+  __set_interrupt_state(state);
+}
+
+/*!
+ \brief Run handlers for pending events, sleep when there are none
+
+ pHandlers is indexed by event number, lower numbers run first. Never
+ returns.
+ */
+void EventLoop(const EventHandler_t *pHandlers, u8_t numHandlers)
+{
+  u16_t pending;
+  u8_t i;
+  
+  while (1)
+  {
+    __disable_interrupt();
+    pending = eventPending;
+    eventPending = 0;
+    
+    if (pending == 0)
+    {
+      /* GIE and LPM are set by the same instruction, no post is missed */
+      EnergyStop(ENERGY_CPU);
+      __bis_SR_register(EVENT_LPM_BITS + GIE);
+      EnergyStart(ENERGY_CPU);
+      continue;
+    }
+    __enable_interrupt();
+    
+    ProbeEnter(PROBE_EVENTS);
+    for (i = 0; i < numHandlers; i++)
+    {
+      if ((pending & (1U << i)) && (pHandlers[i] != NULL_PTR))
+        pHandlers[i]();
+    }
+    ProbeExit(PROBE_EVENTS);
+    ProbeService();
+  }
+}
+
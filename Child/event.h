@@ -0,0 +1,19 @@
+#ifndef _EVENT_H_
+#define _EVENT_H_
+
+#include "common.h"
+
+#define EVENT_MAX             (16)
+
+/* TimerA and the USI run from SMCLK, LPM0 is the deepest mode that keeps it */
+#ifndef EVENT_LPM_BITS
+#define EVENT_LPM_BITS        (LPM0_bits)
+#endif
+
+typedef void (*EventHandler_t)(void);
+
+void EventPost(u8_t event);
+void EventLoop(const EventHandler_t *pHandlers, u8_t numHandlers);
+
+#endif
+
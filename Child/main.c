@@ -1,38 +1,207 @@
 
 #include "common.h"
 #include "nrf24l01.h"
+#include "event.h"
+#include "energy.h"
+#include "probe.h"
+#include "protocol.h"
 
 static void SystemInit(void);
-static u16_t ReadTemperature(void);
+static void StartTemperature(void);
 static void Beep(void);
+static void PacketSent(NRF24L01TxResult_t result);
+static void MeasureHandler(void);
+static void SampledHandler(void);
+static bool ReportDue(u16_t temperature);
+static void BatchReading(u16_t temperature);
+static void BatchDelivered(void);
+static void SentHandler(void);
+static void ExecuteCommand(const u8_t *pCommand, u8_t numBytes);
+static void SetChildAddress(u8_t child);
+static void SyncSlot(u8_t error);
+static void Hop(u8_t index);
+static void AdjustTxPower(void);
 
-//read battery
-
-#define TIMER_A0_RELOAD   (62500)  /* 8us x reload = period) */
+#define TIMER_A0_RELOAD   (PROTOCOL_SUPERFRAME_TICKS)  /* 8us x reload = period) */
+#define TIMER_TRIM_MAX    (TIMER_A0_RELOAD / 64)       /* ~1.5%, per PROTOCOL_CMD_SYNC and in all */
+#define TIMER_ADVANCE_MIN (64)      /* ticks, keeps TACCR0 ahead of TAR */
+#define TIMER_SEND_LATE   (4 * PROTOCOL_SYNC_TICKS)  /* ~8ms after the wakeup, a later report is not synced on */
 #define TIMER_COUNT_MAX   (2)      /* x period = 1sec */
 #define MAX_TEMPERATURE   (763)     /* ~37C */
 #define PIEZO             (P2OUT_bit.P2OUT_6)
+#define TAIV_TACCR1       (2)
+
+#define ADC_SAMPLES       (8)       /* temperature conversions averaged per reading */
+#define ADC_SAMPLES_SHIFT (3)       /* log2(ADC_SAMPLES) */
+#define ADC_BATTERY       (4)       /* Vcc/2 conversions, after the temperature */
+#define ADC_BATTERY_SHIFT (2)
+#define ADC_REF_SETTLE_US (30)      /* tREFON, also the sensor's turn-on */
+
+#ifndef REPORT_DELTA
+#define REPORT_DELTA      (2)       /* ADC codes, ~0.8C, a change sent at once */
+#endif
+
+/* a batch of one is sent only when ReportDue() says so */
+#define BATCH_FULL(count) ((PROTOCOL_BATCH_READINGS > 1) && ((count) >= PROTOCOL_BATCH_READINGS))
+
+#ifndef RADIO_PROFILE
+#define RADIO_PROFILE     (NRF24L01ProfileLowPowerChild)  /* or NRF24L01ProfileLongRange, with its Parent profile */
+#endif
+
+#define LOST_SEND_FAILURES (2)     /* then try the next rate or hop channel */
+#define LINK_HOLD         (PROTOCOL_LINK_TICKS + TIMER_COUNT_MAX)  /* a reading past the Parent's timeout */
+#define TX_POWER_CLEAN    (8)       /* first-try sends before stepping down */
+#define TX_POWER_PROBE    (64)      /* first-try sends before trying below the floor */
+#define TX_POWER_RETRIES  (2)       /* retransmits that step back up */
+
+#ifndef CHILD_ID
+#define CHILD_ID          (0)       /* 0..PROTOCOL_MAX_CHILDREN-1, Parent pipe */
+#endif
+
+/* events, index into eventHandlers[] */
+#define EVENT_MEASURE     (0)
+#define EVENT_SAMPLED     (1)
+#define EVENT_SENT        (2)
+
+static const EventHandler_t eventHandlers[] =
+{
+  MeasureHandler,
+  SampledHandler,
+  SentHandler
+};
 
 static u16_t timerCount = TIMER_COUNT_MAX;
+static u16_t timerReload = TIMER_A0_RELOAD;  /* trimmed to the Parent's clock */
+static u16_t timerAdvance = 0;               /* one-off slot correction */
+static u16_t timerStamp;                     /* TACCR0 at the last wakeup */
+static u8_t timerPeriods = 0xFF;             /* since the last correction, saturates */
+static u8_t sendPeriods;                     /* timerPeriods as the report in the air left, 0 if late */
+static u8_t reportPeriods;                   /* the same for the last one the Parent took */
+static u16_t reportTicks = TIMER_COUNT_MAX;  /* set by PROTOCOL_CMD_SET_RATE */
+static bool silenced = FALSE;                /* set by PROTOCOL_CMD_SILENCE */
+static const u8_t hopSequence[PROTOCOL_HOP_CHANNELS] = PROTOCOL_HOP_SEQUENCE;
+static u8_t hopIndex = 0;                    /* set by PROTOCOL_CMD_HOP */
+static u8_t sendFailures = 0;                /* in a row */
+static u8_t searchSteps = 0;                 /* since last heard */
+static u8_t linkHold = 0;                    /* timer periods left without searching */
+static NRF24L01TxResult_t sendResult;
+static u8_t cleanSends = 0;                  /* in a row, at this power */
+static u8_t powerFloor = NRF24L01_TX_POWER_M18DBM;  /* a retransmit was seen here */
+static u16_t adcSum;                         /* conversions so far, per channel */
+static u8_t adcCount;                        /* conversions so far, this reading */
+static u16_t adcTemperature;                 /* mean of the ADC_SAMPLES */
+static u16_t reported = 0;                   /* temperature the Parent last got */
+static u8_t reportAge = 0;                   /* periods since the Parent last got a report */
+static u8_t reportSequence = 0;              /* per report sent, acknowledged or not */
+static u8_t batch[PROTOCOL_REPORT_HEADER + 2 * PROTOCOL_BATCH_READINGS];  /* the report itself */
+static u8_t batchCount = 0;                  /* readings in batch[] */
+static u8_t batchSent = 0;                   /* of those, in the report in flight */
 
 void main(void)
 {
   SystemInit();
-  NRF24L01Init();
+  
+  /* no Parent pipe, retries would only crowd the channel */
+  if (CHILD_ID >= PROTOCOL_MAX_CHILDREN)
+  {
+    TACCTL0_bit.CCIE = 0;
+    for (;;)
+      __low_power_mode_3();
+  }
+  
+  NRF24L01Init(RADIO_PROFILE);
+  SetChildAddress(CHILD_ID);
+  Hop(0);
   Beep();
   
-  while (1) { /* __low_power_mode_3(); */ };
+  EventLoop(eventHandlers, sizeof(eventHandlers) / sizeof(eventHandlers[0]));
 }
 
-static u16_t ReadTemperature(void)
+/*!
+ \brief Turn the reference on and sample the sensor once it has settled
+
+ TACCR1 times the settling, then ADC_SAMPLES conversions of the sensor
+ and ADC_BATTERY of Vcc/2 follow on the same reference, one per ADC10
+ interrupt. The ISR sums them as they come and turns everything off
+ after the last. The CPU sleeps throughout, EVENT_SAMPLED follows.
+ */
+static void StartTemperature(void)
 {
+  EnergyStart(ENERGY_ADC_REF);
+  adcSum = 0;
+  adcCount = 0;
   ADC10CTL1 = INCH_10 + ADC10DIV_4;
-  ADC10CTL0 = SREF_1 + ADC10SHT_3 + REFON + ADC10ON + ADC10SR;
-  __delay_cycles(10000);
+  ADC10CTL0 = SREF_1 + ADC10SHT_3 + REFON + ADC10ON + ADC10SR + ADC10IE;
+  
+  TACCR1 = TAR + NRF24L01_US_TO_TICKS(ADC_REF_SETTLE_US);
+  TACCTL1_bit.CCIFG = 0;
+  TACCTL1_bit.CCIE = 1;
+}
+
+#pragma vector = TIMERA0_VECTOR
+__interrupt void TimerA0IntrHandler(void)
+{ 
+  ProbeEnter(PROBE_TIMER_ISR);
+  timerStamp = TACCR0;
+  TACCR0 += timerReload - timerAdvance;
+  timerAdvance = 0;
+  if (timerPeriods != 0xFF)
+    timerPeriods++;
+  if (NRF24L01Tick())
+    __low_power_mode_off_on_exit();
+  EnergyTick();
+  ProbeTick();
+  
+  if (--timerCount == 0)
+  {
+    timerCount = reportTicks;
+    EventPost(EVENT_MEASURE);
+    __low_power_mode_off_on_exit();
+  }
+  ProbeExit(PROBE_TIMER_ISR);
+}
+
+#pragma vector = TIMERA1_VECTOR
+__interrupt void TimerA1IntrHandler(void)
+{
+  switch (__even_in_range(TAIV, 10))
+  {
+    case TAIV_TACCR1:
+      /* reference settled, convert */
+      TACCTL1_bit.CCIE = 0;
+      ADC10CTL0 |= ENC + ADC10SC;
+      break;
+      
+    default:
+      break;
+  }
+}
+
+#pragma vector = ADC10_VECTOR
+__interrupt void Adc10IntrHandler(void)
+{
+  adcSum += ADC10MEM;
+  
+  if (++adcCount == ADC_SAMPLES)
+  {
+    /* Vcc/2 next, the reference is still settled */
+    adcTemperature = (adcSum + (ADC_SAMPLES / 2)) >> ADC_SAMPLES_SHIFT;
+    adcSum = 0;
+    ADC10CTL0 &= ~ENC;
+    ADC10CTL1 = INCH_11 + ADC10DIV_4;
+  }
+  else if (adcCount == ADC_SAMPLES + ADC_BATTERY)
+  {
+    /* reference and ADC off, adcSum holds the Vcc/2 conversions */
+    ADC10CTL0 = 0;
+    EnergyStop(ENERGY_ADC_REF);
+    EventPost(EVENT_SAMPLED);
+    __low_power_mode_off_on_exit();
+    return;
+  }
+  
+  /* the next single conversion */
   ADC10CTL0 |= ENC + ADC10SC;
-  while (ADC10CTL1 & ADC10BUSY);
-  ADC10CTL0 &= ~ENC;
-  return ADC10MEM;
 
   /*
     TEMPC = (VTEMP - 0.986) / 0.00355
@@ -42,22 +211,301 @@ static u16_t ReadTemperature(void)
   */
 }
 
-#pragma vector = TIMERA0_VECTOR
-__interrupt void TimerA0IntrHandler(void)
-{ 
-  TACCR0 += TIMER_A0_RELOAD;
+static void MeasureHandler(void)
+{
+  if (reportAge <= 0xFF - reportTicks)
+    reportAge += reportTicks;
+  linkHold = (linkHold > reportTicks) ? linkHold - reportTicks : 0;
   
-  if (--timerCount == 0)
+  /* crystal start-up overlaps the sampling when a report is certain */
+  if (ReportDue(reported) || BATCH_FULL(batchCount + 1))
+    NRF24L01PowerUp();
+  StartTemperature();
+}
+
+static void SampledHandler(void)
+{
+  u16_t temperature;
+  u16_t battery;
+  
+  temperature = adcTemperature;
+  BatchReading(temperature);
+  if (BATCH_FULL(batchCount) || ReportDue(temperature))
+  {
+    /* the FIFO takes a copy, batch[] may fill on while it is in the air */
+    battery = (adcSum + (ADC_BATTERY / 2)) >> ADC_BATTERY_SHIFT;
+    batch[0] = (u8_t)battery;
+    batch[1] = (u8_t)(battery >> 8);
+    batch[2] = reportSequence;
+    if (NRF24L01SendPacketAsync(batch, PROTOCOL_REPORT_HEADER + 2 * batchCount, PacketSent) == RET_SUCCESS)
+    {
+      sendPeriods = ((u16_t)(TAR - timerStamp) < TIMER_SEND_LATE) ? timerPeriods : 0;
+      reportSequence++;
+      batchSent = batchCount;
+      reported = temperature;
+    }
+  }
+  
+  /* after the send, so that it leaves in our slot */
+  if ((temperature > MAX_TEMPERATURE) && !silenced)
+    Beep();
+}
+
+/*
+  Send at once on a move of REPORT_DELTA or more, on crossing
+  MAX_TEMPERATURE and every reading while over it, otherwise readings
+  wait in batch[] for it to fill or for the heartbeat. A failed report
+  clears reported, so the next reading is a retry.
+*/
+static bool ReportDue(u16_t temperature)
+{
+  if (reportAge >= PROTOCOL_HEARTBEAT_TICKS)
+    return TRUE;
+  if ((temperature > MAX_TEMPERATURE) || (reported > MAX_TEMPERATURE))
+    return TRUE;
+  if (temperature >= reported)
+    return (temperature - reported >= REPORT_DELTA);
+  return (reported - temperature >= REPORT_DELTA);
+}
+
+/*
+  Append to batch[]. Without the Parent the oldest reading makes way,
+  including one in flight, that report can then only take the rest.
+*/
+static void BatchReading(u16_t temperature)
+{
+  u8_t *pReading;
+  u8_t i;
+  
+  if (batchCount == PROTOCOL_BATCH_READINGS)
+  {
+    for (i = PROTOCOL_REPORT_HEADER; i < sizeof(batch) - 2; i++)
+      batch[i] = batch[i + 2];
+    batchCount--;
+    if (batchSent)
+      batchSent--;
+  }
+  
+  pReading = &batch[PROTOCOL_REPORT_HEADER + 2 * batchCount++];
+  pReading[0] = (u8_t)temperature;
+  pReading[1] = (u8_t)(temperature >> 8);
+}
+
+/* drop the readings the Parent has, keep any taken since */
+static void BatchDelivered(void)
+{
+  u8_t i;
+  
+  batchCount -= batchSent;
+  for (i = PROTOCOL_REPORT_HEADER; i < PROTOCOL_REPORT_HEADER + 2 * batchCount; i++)
+    batch[i] = batch[i + 2 * batchSent];
+  batchSent = 0;
+}
+
+/* called from interrupt context when the send has completed */
+static void PacketSent(NRF24L01TxResult_t result)
+{
+  sendResult = result;
+  EventPost(EVENT_SENT);
+}
+
+/* a failed report is retried with the next reading */
+static void SentHandler(void)
+{
+  u8_t command[PROTOCOL_CMD_SIZE];
+  u8_t numBytes;
+  
+  /* the Parent's command rides back on the ACK */
+  numBytes = NRF24L01ReadAckPayload(command, sizeof(command));
+  NRF24L01PowerDown();
+  ExecuteCommand(command, numBytes);
+  AdjustTxPower();
+  
+  /* the Parent may have changed rate or channel without us */
+  if (sendResult == NRF24L01_TX_SENT)
+  {
+    reportPeriods = sendPeriods;
+    BatchDelivered();
+    reportAge = 0;
+    sendFailures = 0;
+    searchSteps = 0;
+    return;
+  }
+  
+  reported = 0;
+  batchSent = 0;
+  /* the Parent follows a change we took within PROTOCOL_LINK_TICKS */
+  if (linkHold != 0)
+    return;
+  if (++sendFailures >= LOST_SEND_FAILURES)
+  {
+    /* the other rate, then the next channel, whatever the profile began with */
+    sendFailures = 0;
+    NRF24L01SetDataRate(!NRF24L01GetDataRate());
+    if ((++searchSteps & 1) == 0)
+      Hop((hopIndex + 1) % PROTOCOL_HOP_CHANNELS);
+  }
+}
+
+static void ExecuteCommand(const u8_t *pCommand, u8_t numBytes)
+{
+  if (numBytes < PROTOCOL_CMD_SIZE)
+    return;
+  
+  switch (pCommand[0])
   {
-    u16_t temperature;
-    timerCount = TIMER_COUNT_MAX;
-    temperature = ReadTemperature();
-    if (temperature > MAX_TEMPERATURE)
+    case PROTOCOL_CMD_LOCATE:
       Beep();
-    NRF24L01SendPacket((u8_t *)&temperature, 2);
+      __delay_cycles(65536);
+      Beep();
+      __delay_cycles(65536);
+      Beep();
+      break;
+      
+    case PROTOCOL_CMD_SET_RATE:
+      if (pCommand[1] != 0)
+        reportTicks = pCommand[1];
+      break;
+      
+    case PROTOCOL_CMD_SILENCE:
+      silenced = pCommand[1] ? TRUE : FALSE;
+      break;
+      
+    case PROTOCOL_CMD_SYNC:
+      /* measured on our last report, stale unless it left after the last correction */
+      if (reportPeriods >= 2)
+        SyncSlot(pCommand[1]);
+      break;
+      
+    case PROTOCOL_CMD_HOP:
+      if (pCommand[1] < PROTOCOL_HOP_CHANNELS)
+      {
+        Hop(pCommand[1]);
+        linkHold = LINK_HOLD;
+      }
+      break;
+      
+    case PROTOCOL_CMD_AIR_RATE:
+      NRF24L01SetDataRate(pCommand[1]);
+      linkHold = LINK_HOLD;
+      break;
   }
 }
 
+/*
+  error is how late, in PROTOCOL_SYNC_TICKS, our packet reached the
+  Parent. The next wakeup is brought forward by that much. When early
+  it is put back by that much if the 16-bit period has room, otherwise
+  brought forward by the rest of the superframe, since every
+  superframe has our slot. The correction is in place from the second
+  timer period on, a report that left earlier is not synced on.
+  Whatever is left at the next sync is rate mismatch between the two
+  clocks over the periods the report ran corrected, half of it comes
+  out of the reload. The first sync after power-up is all phase. The
+  reload stays within TIMER_TRIM_MAX of nominal, so a late packet that
+  was not drift cannot run it away, and the advance cannot wrap.
+*/
+static void SyncSlot(u8_t error)
+{
+  s16_t late;
+  u16_t advance;
+  s16_t trim;
+  s16_t reload;
+  
+  late = error;
+  if (error & 0x80)
+    late -= 256;
+  late *= PROTOCOL_SYNC_TICKS;
+  
+  trim = late / (s16_t)(2 * (reportPeriods - 1));
+  if (trim > TIMER_TRIM_MAX)
+    trim = TIMER_TRIM_MAX;
+  else if (trim < -TIMER_TRIM_MAX)
+    trim = -TIMER_TRIM_MAX;
+  
+  reload = (s16_t)(timerReload - TIMER_A0_RELOAD) - trim;
+  if (reload > TIMER_TRIM_MAX)
+    reload = TIMER_TRIM_MAX;
+  else if (reload < -TIMER_TRIM_MAX)
+    reload = -TIMER_TRIM_MAX;
+  
+  if ((late < 0) && ((s32_t)TIMER_A0_RELOAD + reload - late <= 0xFFFF))
+    advance = (u16_t)late;  /* wraps, the period grows by -late */
+  else
+  {
+    advance = (late >= 0) ? (u16_t)late : (u16_t)(late + TIMER_A0_RELOAD);
+    if (advance > (u16_t)(TIMER_A0_RELOAD + reload - TIMER_ADVANCE_MIN))
+      advance = (u16_t)(TIMER_A0_RELOAD + reload - TIMER_ADVANCE_MIN);
+  }
+  
+  __disable_interrupt();
+  timerReload = TIMER_A0_RELOAD + reload;
+  timerAdvance = advance;
+  timerPeriods = 0;
+  __enable_interrupt();
+}
+
+/*
+  Lowest RF_PWR that still gets through first time. A failed send goes
+  straight back to full power, retransmits step up, a run of clean
+  sends steps down. Stepping down stops at the first retransmit, well
+  before sends fail, and only a much longer run tries below that floor.
+*/
+static void AdjustTxPower(void)
+{
+  u8_t power = NRF24L01GetTxPower();
+  u8_t retransmits = NRF24L01GetTxStats()->lastRetransmits;
+  
+  if (sendResult != NRF24L01_TX_SENT)
+  {
+    power = NRF24L01_TX_POWER_0DBM;
+    powerFloor = power;
+    cleanSends = 0;
+  }
+  else if (retransmits >= TX_POWER_RETRIES)
+  {
+    if (power < NRF24L01_TX_POWER_0DBM)
+      power++;
+    powerFloor = power;
+    cleanSends = 0;
+  }
+  else if (retransmits != 0)
+  {
+    if (powerFloor < power)
+      powerFloor = power;
+  }
+  else if (++cleanSends >= ((power > powerFloor) ? TX_POWER_CLEAN : TX_POWER_PROBE))
+  {
+    if (power > NRF24L01_TX_POWER_M18DBM)
+      power--;
+    if (powerFloor > power)
+      powerFloor = power;
+    cleanSends = 0;
+  }
+  
+  NRF24L01SetTxPower(power);
+}
+
+static void Hop(u8_t index)
+{
+  hopIndex = index;
+  NRF24L01SetChannel(hopSequence[index]);
+}
+
+/* TX address selects our Parent pipe, ACKs come back on pipe 0 */
+static void SetChildAddress(u8_t child)
+{
+  u8_t addr[NRF24L01_MAX_ADDR_WIDTH];
+  u8_t i;
+  
+  addr[0] = PROTOCOL_ADDR_LSB + child;
+  for (i = 1; i < sizeof(addr); i++)
+    addr[i] = PROTOCOL_ADDR_MSB;
+  
+  NRF24L01SetTxAddress(addr);
+  NRF24L01SetRxAddress(0, addr);
+}
+
 static void SystemInit(void)
 {
   /* stop watchdog */
@@ -65,6 +513,10 @@ static void SystemInit(void)
     
   /* delay for ~65ms (clock is ~1MHz at power-up) for Vcc to stabilize */
   __delay_cycles(65536);
+  
+  /* factory 1MHz DCO calibration, TimerA times the radio and the slots */
+  BCSCTL1 = CALBC1_1MHZ;
+  DCOCTL = CALDCO_1MHZ;
 
   /* setup port 1 */
   P1SEL = BIT5 + BIT6 + BIT7;
@@ -84,6 +536,7 @@ static void SystemInit(void)
   TACCTL0_bit.CCIFG = 0;
   TACCTL0_bit.CCIE = 1;
   TACCTL1_bit.CCIE = 0;
+  EnergyStart(ENERGY_CPU);
   
     /* setup USI */
   USICTL0 |= USIPE5 + USIPE6 + USIPE7 + USIMST + USIOE;
@@ -98,9 +551,12 @@ static void SystemInit(void)
 static void Beep(void)
 {
   u16_t counter = 1000;
+  
+  EnergyStart(ENERGY_BEEP);
   while (counter--)
   {
     __delay_cycles(126);
     PIEZO ^= 1;
   }
+  EnergyStop(ENERGY_BEEP);
 }
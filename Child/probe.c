@@ -0,0 +1,119 @@
+
+/*! \file probe.c
+    \brief Execution time probes and their pulse train dump
+*/
+
+#include "common.h"
+#include "probe.h"
+
+#ifdef PROBE_TIMING
+
+/*
+  Pulse train: a PROBE_SYNC_UNITS high sync, then per probe count and
+  total (32 bits), min and max (16 bits), MSB first. A bit is high for
+  one unit (0) or three (1), then low for one; interrupts can only
+  stretch the low part.
+*/
+#define PROBE_PIN             (P1OUT_bit.P1OUT_0)
+#define PROBE_BIT             (BIT0)
+#define PROBE_UNIT_CYCLES     (32)
+#define PROBE_SYNC_UNITS      (16)
+
+Probe_t probes[PROBE_MAX];
+
+static u16_t probeSince[PROBE_MAX];
+static u16_t dumpTicks = 0;
+static volatile bool dumpDue = FALSE;
+
+static void ProbeSendBits(u32_t value, u8_t numBits);
+
+/*!
+ \brief Start timing a section
+ */
+void ProbeEnter(u8_t probe)
+{
+  probeSince[probe] = TAR;
+}
+
+/*!
+ \brief End timing a section, safe from ISRs
+ */
+void ProbeExit(u8_t probe)
+{
+  u16_t ticks = TAR - probeSince[probe];
+  Probe_t *pProbe = &probes[probe];
+  __istate_t istate = __get_interrupt_state();
+
+  __disable_interrupt();
+  if ((pProbe->count == 0) || (ticks < pProbe->min))
+    pProbe->min = ticks;
+  if (ticks > pProbe->max)
+    pProbe->max = ticks;
+  pProbe->total += ticks;
+  pProbe->count++;
+  __set_interrupt_state(istate);
+}
+
+/*!
+ \brief Call from the TimerA0 ISR, schedules the dump
+ */
+void ProbeTick(void)
+{
+  if (PROBE_DUMP_TICKS && (++dumpTicks >= PROBE_DUMP_TICKS))
+  {
+    dumpTicks = 0;
+    dumpDue = TRUE;
+  }
+}
+
+/*!
+ \brief Send probes[] out on PROBE_PIN when a dump is due
+
+ Call from main with interrupts enabled, a dump takes ~50ms.
+ */
+void ProbeService(void)
+{
+  Probe_t probe;
+  u8_t i;
+
+  if (!dumpDue)
+    return;
+  dumpDue = FALSE;
+
+  P1DIR |= PROBE_BIT;
+  PROBE_PIN = 1;
+  __delay_cycles(PROBE_SYNC_UNITS * PROBE_UNIT_CYCLES);
+  PROBE_PIN = 0;
+  __delay_cycles(PROBE_UNIT_CYCLES);
+
+  for (i = 0; i < PROBE_MAX; i++)
+  {
+    __disable_interrupt();
+    probe = probes[i];
+    __enable_interrupt();
+
+    ProbeSendBits(probe.count, 32);
+    ProbeSendBits(probe.total, 32);
+    ProbeSendBits(probe.min, 16);
+    ProbeSendBits(probe.max, 16);
+  }
+}
+
+static void ProbeSendBits(u32_t value, u8_t numBits)
+{
+  value <<= 32 - numBits;
+  while (numBits--)
+  {
+    __disable_interrupt();
+    PROBE_PIN = 1;
+    __delay_cycles(PROBE_UNIT_CYCLES);
+    if (value & 0x80000000UL)
+      __delay_cycles(2 * PROBE_UNIT_CYCLES);
+    PROBE_PIN = 0;
+    __enable_interrupt();
+    __delay_cycles(PROBE_UNIT_CYCLES);
+    value <<= 1;
+  }
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _PROBE_H_
+#define _PROBE_H_
+
+#include "common.h"
+
+/*
+  Execution time probes. ProbeEnter()/ProbeExit() timestamp a section
+  with TAR and keep count, min, max and total in probes[], in TimerA
+  ticks of 8 cycles; the ~6 cycles of interrupt entry are not seen.
+  ProbeService() sends them out as a pulse train on PROBE_PIN every
+  PROBE_DUMP_TICKS timer periods, 0 never. Off by default, the hooks
+  then cost nothing; on, they take 59 bytes of RAM.
+*/
+#define PROBE_TIMER_ISR       (0)   /* TimerA0IntrHandler */
+#define PROBE_RADIO_ISR       (1)   /* NRF24L01IrqHandler */
+#define PROBE_SEND            (2)   /* NRF24L01SendPacket(Async) */
+#define PROBE_EVENTS          (3)   /* event handlers run on one wake-up */
+#define PROBE_MAX             (4)
+
+#ifndef PROBE_DUMP_TICKS
+#define PROBE_DUMP_TICKS      (120)
+#endif
+
+typedef struct
+{
+  u32_t count;
+  u32_t total;
+  u16_t min;
+  u16_t max;
+} Probe_t;
+
+#ifdef PROBE_TIMING
+
+extern Probe_t probes[PROBE_MAX];
+
+void ProbeEnter(u8_t probe);
+void ProbeExit(u8_t probe);
+void ProbeTick(void);
+void ProbeService(void);
+
+#else
+
+#define ProbeEnter(probe)     ((void)0)
+#define ProbeExit(probe)      ((void)0)
+#define ProbeTick()           ((void)0)
+#define ProbeService()        ((void)0)
+
+#endif
+
+#endif
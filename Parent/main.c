@@ -1,54 +1,589 @@
-
 #include "common.h"
 #include "nrf24l01.h"
+#include "event.h"
+#include "energy.h"
+#include "probe.h"
+#include "protocol.h"
 
 static void SystemInit(void);
 static void Beep(void);
+static void Alarm(u8_t child, u8_t groups);
+static void AlarmWait(void);
+static void SoundAlarms(void);
+static void PacketReceived(void);
+static void ReceiveHandler(void);
+static void ChildPacket(u8_t child, const u8_t *pPacket, u8_t numBytes);
+static void LinkLostHandler(void);
+static void QueueCommand(u8_t child, u8_t command, u8_t argument);
+static void ServiceCommands(void);
+static void EnableChildPipes(void);
+static u8_t SlotError(u8_t child, u16_t offset);
+static void SuperframeHandler(void);
+static void SurveyChannels(void);
+static u8_t NextHop(u8_t index);
+static void CheckAirRate(void);
+static void StartLinkChange(u8_t command, u8_t argument);
+static void CheckLinkChange(bool timeout);
 
-#define TIMER_A0_RELOAD   (62500)  /* 8us x reload = period = 500ms) */
-#define TIMER_COUNT_MAX   (10)     /* x period = 5sec */
+#define TIMER_A0_RELOAD   (PROTOCOL_SUPERFRAME_TICKS)  /* 8us x reload = period = 500ms) */
+#define TIMER_COUNT_MAX   (2 * PROTOCOL_HEARTBEAT_TICKS + NORMAL_REPORT_TICKS)  /* a missed heartbeat, the next and a report */
 #define PIEZO             (P2OUT_bit.P2OUT_6)
 #define MAX_TEMPERATURE   (763)     /* ~37C */
+#define LOW_BATTERY       (818)     /* Vcc/2 code, Vcc ~2.4V */
+#define LOW_BATTERY_CLEAR (LOW_BATTERY + 16)  /* ~50mV over, a fresh cell */
+#define FEVER_REPORT_TICKS  (1)     /* child report period while feverish */
+#define NORMAL_REPORT_TICKS (2)     /* x 500ms = 1sec */
+
+#ifndef RADIO_PROFILE
+#define RADIO_PROFILE     (NRF24L01ProfileListeningParent)  /* or NRF24L01ProfileLongRangeParent */
+#endif
+
+#ifndef NUM_CHILDREN
+#define NUM_CHILDREN      (1)       /* watched from power-up, <= PROTOCOL_MAX_CHILDREN */
+#endif
+
+#define SLOT_TICKS        (TIMER_A0_RELOAD / NUM_CHILDREN)
+#define REPORT_SIZE       (PROTOCOL_REPORT_HEADER + 2 * PROTOCOL_BATCH_READINGS)  /* the longest, sizes the RX buffer */
+
+/* carrier detect, whole band at power-up then the current channel */
+#define SURVEY_SAMPLES    (32)      /* per channel */
+#define SURVEY_BUSY       (SURVEY_SAMPLES / 8)
+#define CD_SAMPLES        (8)       /* at each superframe start, between slots */
+#define CD_WINDOW         (32)      /* superframes = 16sec */
+#define CD_BUSY           (CD_SAMPLES * CD_WINDOW / 4)
+
+/* air rate, from reports missing per window */
+#define RATE_WINDOW       (8 * PROTOCOL_HEARTBEAT_TICKS)  /* superframes, 8 heartbeats */
+#define RATE_LOSS_DIV     (8)       /* over 1/8 missing falls back to 1Mbps */
+#define RATE_PROBE_MIN    (4)       /* clean windows at 1Mbps before trying 2Mbps */
+#define RATE_PROBE_MAX    (32)
+#define SEQUENCE_GAP_MAX  (TIMER_COUNT_MAX / FEVER_REPORT_TICKS)  /* reports before link lost, more is a restart */
+
+/* alarm beep groups, the child is told by the number of beeps per group */
+#define ALARM_FEVER       (1)
+#define ALARM_LINK_LOST   (2)
+#define ALARM_LOW_BATTERY (3)
+
+/* events, index into eventHandlers[] */
+#define EVENT_RECEIVE     (0)
+#define EVENT_LINK_LOST   (1)
+#define EVENT_SUPERFRAME  (2)
+
+static const EventHandler_t eventHandlers[] =
+{
+  ReceiveHandler,
+  LinkLostHandler,
+  SuperframeHandler
+};
+
+typedef struct
+{
+  u8_t timerCount;                    /* periods left before link lost */
+  u8_t commandQueued;                 /* in the TX FIFO for the next ACK, or 0 */
+  u8_t command[PROTOCOL_CMD_SIZE];    /* waiting for the FIFO, [0]=0 if none */
+  u8_t packets;                       /* this rate window */
+  u8_t missing;                       /* this rate window, from sequence gaps */
+  u8_t sequence;                      /* of the last report */
+} Child_t;
 
-static u16_t timerCount = TIMER_COUNT_MAX;
+static Child_t children[NUM_CHILDREN];
+static u8_t lostChildren = 0;         /* bit per child, from the timer */
+static u8_t feverAlarms = 0;          /* bit per child, sounded after the FIFO is drained */
+static u8_t batteryAlarms = 0;
+static u8_t feverChildren = 0;        /* bit per child, reporting at the fever rate */
+static u8_t lowBatteries = 0;         /* bit per child, alarmed until the cell reads good */
+static u8_t heardChildren = 0;        /* bit per child, sequence is valid */
+static u16_t superframeStart;         /* TAR at the last timer period */
+static u16_t rxOffset;                /* into the superframe, of the last packet */
+static bool rxStamped = FALSE;        /* rxOffset not yet used by a packet */
+static const u8_t hopSequence[PROTOCOL_HOP_CHANNELS] = PROTOCOL_HOP_SEQUENCE;
+static u16_t hopBusy = 0;             /* bit per hop index */
+static u8_t hopIndex;                 /* current channel */
+static u8_t linkCommand = 0;          /* HOP or AIR_RATE the children are told, or 0 */
+static u8_t linkArgument;
+static u8_t linkWait;                 /* superframes since then */
+static u8_t rateCount = 0;            /* superframes in this rate window */
+static u8_t rateClean = 0;            /* windows in a row without loss at 1Mbps */
+static u8_t rateProbe = RATE_PROBE_MIN;
+static bool rateProbing = FALSE;      /* 2Mbps on trial */
+static u16_t carrierHits = 0;
+static u8_t carrierCount = 0;         /* superframes sampled */
 
 void main(void)
 {
+  u8_t child;
+  
   SystemInit();
-  NRF24L01Init();
+  NRF24L01Init(RADIO_PROFILE);
+  EnableChildPipes();
+  SurveyChannels();
+  for (child = 0; child < NUM_CHILDREN; child++)
+    children[child].timerCount = TIMER_COUNT_MAX;
   Beep();
   __delay_cycles(65536);
   Beep();
   
   NRF24L01StartReceiveMode();
+  NRF24L01EnableRxInterrupt(PacketReceived);
  
-  while (1) { /* __low_power_mode_3(); */ };
+  EventLoop(eventHandlers, sizeof(eventHandlers) / sizeof(eventHandlers[0]));
+}
+
+/* child n on pipe n, dynamic payload length with auto-ack */
+static void EnableChildPipes(void)
+{
+  u8_t addr[NRF24L01_MAX_ADDR_WIDTH];
+  u8_t pipe;
+  u8_t i;
+  
+  for (i = 1; i < sizeof(addr); i++)
+    addr[i] = PROTOCOL_ADDR_MSB;
+  
+  for (pipe = 0; pipe < NRF24L01_MAX_PIPES; pipe++)
+  {
+    if (pipe < NUM_CHILDREN)
+    {
+      addr[0] = PROTOCOL_ADDR_LSB + pipe;
+      NRF24L01EnableRxPipe(pipe, addr, 0);
+    }
+    else
+      NRF24L01DisableRxPipe(pipe);
+  }
 }
 
 #pragma vector = TIMERA0_VECTOR
 __interrupt void TimerA0IntrHandler(void)
 { 
+  u8_t child;
+  
+  ProbeEnter(PROBE_TIMER_ISR);
+  superframeStart = TACCR0;
   TACCR0 += TIMER_A0_RELOAD;
+  EnergyTick();
+  ProbeTick();
   
-  if (NRF24L01IsPacketReceived())
+  for (child = 0; child < NUM_CHILDREN; child++)
   {
-    u16_t temperature;
+    if (--children[child].timerCount == 0)
+    {
+      children[child].timerCount = TIMER_COUNT_MAX;
+      lostChildren |= 1 << child;
+    }
+  }
+  
+  if (lostChildren)
+    EventPost(EVENT_LINK_LOST);
+  EventPost(EVENT_SUPERFRAME);
+  __low_power_mode_off_on_exit();
+  ProbeExit(PROBE_TIMER_ISR);
+}
+
+/* called from the nRF24L01 IRQ interrupt */
+static void PacketReceived(void)
+{
+  rxOffset = TAR - superframeStart;
+  rxStamped = TRUE;
+  EventPost(EVENT_RECEIVE);
+}
+
+/* up to three packets may be queued, all of them are taken */
+static void ReceiveHandler(void)
+{
+  u8_t packet[REPORT_SIZE];
+  
+  NRF24L01DrainRxFifo(packet, sizeof(packet), ChildPacket);
+  ServiceCommands();
+  if (linkCommand != 0)
+    CheckLinkChange(FALSE);
+  SoundAlarms();
+}
+
+/* the pipe is the child */
+static void ChildPacket(u8_t child, const u8_t *pPacket, u8_t numBytes)
+{
+  Child_t *pChild;
+  u16_t temperature;
+  u16_t battery;
+  u8_t lost;
+  u8_t i;
+  bool synced;
+  bool stamped;
     
-    timerCount = TIMER_COUNT_MAX;
-    NRF24L01ReadFifo((u8_t *)&temperature, 2);
-    NRF24L01EndReceiveMode();
-    NRF24L01StartReceiveMode();
-    if (temperature > MAX_TEMPERATURE)
-      Beep();
+  /* one stamp per IRQ edge, it dates the first packet taken after it only */
+  stamped = rxStamped;
+  rxStamped = FALSE;
+  
+  if (child >= NUM_CHILDREN)
+    return;
+  
+  pChild = &children[child];
+  pChild->timerCount = TIMER_COUNT_MAX;
+  if (pChild->packets < 0xFF)
+    pChild->packets++;
+  
+  /* the ACK to this packet carried any queued command */
+  synced = (pChild->commandQueued == PROTOCOL_CMD_SYNC);
+  pChild->commandQueued = 0;
+  
+  /*
+    Keep the child in its slot, unless this packet left before it
+    applied the last correction or waited in the FIFO behind another,
+    so that its arrival is unknown. Other commands take precedence.
+  */
+  if (stamped && !synced && (pChild->command[0] == 0))
+  {
+    pChild->command[1] = SlotError(child, rxOffset);
+    if (pChild->command[1] != 0)
+      pChild->command[0] = PROTOCOL_CMD_SYNC;
+  }
+  
+  if (numBytes < PROTOCOL_REPORT_HEADER + sizeof(temperature))
+    return;
+  
+  /*
+    Battery and sequence lead the frame, one alarm as the battery goes
+    low. Neither the first report since we restarted, nor a report 0
+    after a gap, the child restarted, nor a gap longer than a link
+    timeout is an air rate loss.
+  */
+  battery = pPacket[0] | ((u16_t)pPacket[1] << 8);
+  lost = pPacket[2] - pChild->sequence - 1;
+  if (!(heardChildren & (1 << child)) || (pPacket[2] == 0) || (lost > SEQUENCE_GAP_MAX))
+    lost = 0;
+  heardChildren |= 1 << child;
+  pChild->sequence = pPacket[2];
+  pChild->missing = (pChild->missing <= 0xFF - lost) ? pChild->missing + lost : 0xFF;
+  
+  if (!(lowBatteries & (1 << child)) && (battery < LOW_BATTERY))
+  {
+    lowBatteries |= 1 << child;
+    batteryAlarms |= 1 << child;
+  }
+  else if (battery >= LOW_BATTERY_CLEAR)
+    lowBatteries &= ~(1 << child);
+  
+  /* then the batch of temperatures, oldest first, the last one leaves the fever state */
+  for (i = PROTOCOL_REPORT_HEADER; i + 1 < numBytes; i += sizeof(temperature))
+  {
+    temperature = pPacket[i] | ((u16_t)pPacket[i + 1] << 8);
+    
+    /* watch a feverish child more closely */
+    if ((temperature > MAX_TEMPERATURE) != ((feverChildren & (1 << child)) != 0))
+    {
+      feverChildren ^= 1 << child;
+      QueueCommand(child, PROTOCOL_CMD_SET_RATE, (feverChildren & (1 << child)) ? FEVER_REPORT_TICKS : NORMAL_REPORT_TICKS);
+    }
+    
+    if (feverChildren & (1 << child))
+      feverAlarms |= 1 << child;
+  }
+}
+
+/* replaces a command that has not reached the TX FIFO yet */
+static void QueueCommand(u8_t child, u8_t command, u8_t argument)
+{
+  children[child].command[0] = command;
+  children[child].command[1] = argument;
+}
+
+/*
+  One ACK payload per child in the TX FIFO, the pipe's next ACK takes
+  it. A child's next command waits here until its packet shows the
+  previous one went out. Room is read from the FIFO itself, an ACK
+  can take a payload at any time.
+*/
+static void ServiceCommands(void)
+{
+  Child_t *pChild;
+  u8_t child;
+  
+  for (child = 0; child < NUM_CHILDREN; child++)
+  {
+    pChild = &children[child];
+    if ((pChild->command[0] != 0) && !pChild->commandQueued)
+    {
+      if (NRF24L01ReadFifoStatus() & NRF24L01_FIFO_STATUS_TX_FULL)
+        return;
+      if (NRF24L01WriteAckPayload(child, pChild->command, sizeof(pChild->command)) == RET_SUCCESS)
+      {
+        pChild->commandQueued = pChild->command[0];
+        pChild->command[0] = 0;
+      }
+    }
+  }
+}
+
+/*
+  Score every channel, a hop channel is busy when it or a 1MHz
+  neighbour shows a carrier. Starts on the first quiet hop channel.
+*/
+static void SurveyChannels(void)
+{
+  u8_t channel;
+  u8_t i;
+  
+  for (channel = 0; channel <= NRF24L01_MAX_CHANNEL; channel++)
+  {
+    if (NRF24L01SurveyChannel(channel, SURVEY_SAMPLES) > SURVEY_BUSY)
+    {
+      for (i = 0; i < PROTOCOL_HOP_CHANNELS; i++)
+      {
+        if ((hopSequence[i] + 1 >= channel) && (hopSequence[i] <= channel + 1))
+          hopBusy |= 1U << i;
+      }
+    }
+  }
+  
+  hopIndex = NextHop(PROTOCOL_HOP_CHANNELS - 1);
+  NRF24L01SetChannel(hopSequence[hopIndex]);
+}
+
+/* first hop after index that is not busy */
+static u8_t NextHop(u8_t index)
+{
+  u8_t i;
+  
+  for (i = 0; i < PROTOCOL_HOP_CHANNELS; i++)
+  {
+    index = (index + 1) % PROTOCOL_HOP_CHANNELS;
+    if (!(hopBusy & (1U << index)))
+      return index;
   }
   
-  if (--timerCount == 0)
+  /* all busy, the survey is stale by now */
+  hopBusy = 0;
+  return (index + 1) % PROTOCOL_HOP_CHANNELS;
+}
+
+/* sample our own channel, outside any slot */
+static void SuperframeHandler(void)
+{
+  carrierHits += NRF24L01ReadCarrier(CD_SAMPLES);
+  if (++carrierCount >= CD_WINDOW)
+  {
+    if ((carrierHits > CD_BUSY) && (linkCommand == 0))
+    {
+      hopBusy |= 1U << hopIndex;
+      StartLinkChange(PROTOCOL_CMD_HOP, NextHop(hopIndex));
+    }
+    carrierHits = 0;
+    carrierCount = 0;
+  }
+  
+  if (++rateCount >= RATE_WINDOW)
+  {
+    rateCount = 0;
+    CheckAirRate();
+  }
+  
+  if (linkCommand != 0)
+    CheckLinkChange(++linkWait >= PROTOCOL_LINK_TICKS);
+}
+
+/*
+  Count the reports missing this window from children we have heard.
+  Too many at 2Mbps falls back to 1Mbps. A run of clean windows at
+  1Mbps tries 2Mbps again, a trial that fails doubles the run.
+*/
+static void CheckAirRate(void)
+{
+  Child_t *pChild;
+  u16_t expected = 0;
+  u16_t missing = 0;
+  u8_t child;
+  
+  /* children report on change, the sequence tells what went missing */
+  for (child = 0; child < NUM_CHILDREN; child++)
+  {
+    pChild = &children[child];
+    expected += pChild->packets + pChild->missing;
+    missing += pChild->missing;
+    pChild->packets = 0;
+    pChild->missing = 0;
+  }
+  
+  if (linkCommand != 0)
+    return;
+  
+  if (NRF24L01GetDataRate() == NRF24L01_DATA_RATE_2MBPS)
+  {
+    if (missing * RATE_LOSS_DIV > expected)
+    {
+      if (rateProbing && (rateProbe < RATE_PROBE_MAX))
+        rateProbe *= 2;
+      rateClean = 0;
+      StartLinkChange(PROTOCOL_CMD_AIR_RATE, NRF24L01_DATA_RATE_1MBPS);
+    }
+    else if (rateProbing)
+      rateProbe = RATE_PROBE_MIN;
+    rateProbing = FALSE;
+  }
+  else if ((expected != 0) && (missing == 0))
   {
-    timerCount = TIMER_COUNT_MAX;
-    Beep();
-    __delay_cycles(65536);
-    Beep();
+    if (++rateClean >= rateProbe)
+    {
+      rateClean = 0;
+      rateProbing = TRUE;
+      StartLinkChange(PROTOCOL_CMD_AIR_RATE, NRF24L01_DATA_RATE_2MBPS);
+    }
   }
+  else
+    rateClean = 0;
+}
+
+/* rides on each child's next ACK, ahead of other commands */
+static void StartLinkChange(u8_t command, u8_t argument)
+{
+  u8_t child;
+  
+  linkCommand = command;
+  linkArgument = argument;
+  linkWait = 0;
+  for (child = 0; child < NUM_CHILDREN; child++)
+    QueueCommand(child, command, argument);
+  ServiceCommands();
+}
+
+/*
+  Follow the children once every change has gone out, or on timeout,
+  leaving any child that missed it to search for us. Those that took it
+  have been failing to reach us meanwhile, their link timers restart.
+*/
+static void CheckLinkChange(bool timeout)
+{
+  u8_t child;
+  u8_t missed = 0;                    /* bit per child */
+  
+  if (timeout)
+  {
+    NRF24L01FlushAckPayloads();
+    for (child = 0; child < NUM_CHILDREN; child++)
+    {
+      if ((children[child].commandQueued == linkCommand) || (children[child].command[0] == linkCommand))
+        missed |= 1 << child;
+      children[child].commandQueued = 0;
+      if (children[child].command[0] == linkCommand)
+        children[child].command[0] = 0;
+    }
+  }
+  else
+  {
+    for (child = 0; child < NUM_CHILDREN; child++)
+    {
+      if (children[child].command[0] == linkCommand)
+        return;
+    }
+    if (!(NRF24L01ReadFifoStatus() & NRF24L01_FIFO_STATUS_TX_EMPTY))
+      return;
+  }
+  
+  if (linkCommand == PROTOCOL_CMD_HOP)
+  {
+    hopIndex = linkArgument;
+    NRF24L01SetChannel(hopSequence[hopIndex]);
+  }
+  else
+    NRF24L01SetDataRate(linkArgument);
+  linkCommand = 0;
+  
+  /* the changeover itself costs reports, start a fresh rate window */
+  rateCount = 0;
+  for (child = 0; child < NUM_CHILDREN; child++)
+  {
+    children[child].packets = 0;
+    children[child].missing = 0;
+    if (!(missed & (1 << child)))
+      children[child].timerCount = TIMER_COUNT_MAX;
+  }
+}
+
+/* how late offset is for the middle of the child's slot, PROTOCOL_CMD_SYNC */
+static u8_t SlotError(u8_t child, u16_t offset)
+{
+  s32_t late;
+  
+  /* the timer interrupt may not have run yet */
+  if (offset >= TIMER_A0_RELOAD)
+    offset -= TIMER_A0_RELOAD;
+  
+  late = (s32_t)offset - (child * SLOT_TICKS + SLOT_TICKS / 2);
+  if (late >= TIMER_A0_RELOAD / 2)
+    late -= TIMER_A0_RELOAD;
+  else if (late < -(TIMER_A0_RELOAD / 2))
+    late += TIMER_A0_RELOAD;
+  
+  /* rounded, two's complement */
+  late += PROTOCOL_SYNC_TICKS / 2;
+  if (late < 0)
+    late -= PROTOCOL_SYNC_TICKS - 1;
+  return (u8_t)(late / PROTOCOL_SYNC_TICKS);
+}
+
+static void LinkLostHandler(void)
+{
+  u8_t lost;
+  u8_t child;
+  
+  __disable_interrupt();
+  lost = lostChildren;
+  lostChildren = 0;
+  __enable_interrupt();
+  
+  for (child = 0; child < NUM_CHILDREN; child++)
+  {
+    if (lost & (1 << child))
+      Alarm(child, ALARM_LINK_LOST);
+  }
+}
+
+/* alarms raised by packets, those raised while sounding wait for the next receive event */
+static void SoundAlarms(void)
+{
+  u8_t fever = feverAlarms;
+  u8_t battery = batteryAlarms;
+  u8_t child;
+  
+  feverAlarms = 0;
+  batteryAlarms = 0;
+  for (child = 0; child < NUM_CHILDREN; child++)
+  {
+    if (fever & (1 << child))
+      Alarm(child, ALARM_FEVER);
+    if (battery & (1 << child))
+      Alarm(child, ALARM_LOW_BATTERY);
+  }
+}
+
+/* groups of (child + 1) beeps */
+static void Alarm(u8_t child, u8_t groups)
+{
+  u8_t i;
+  
+  while (groups--)
+  {
+    for (i = 0; i <= child; i++)
+    {
+      Beep();
+      AlarmWait();
+    }
+    AlarmWait();
+    AlarmWait();
+  }
+}
+
+/*
+  ~65ms between beeps, packets are taken meanwhile so that the RX FIFO
+  keeps room and the children keep getting ACKs. Called from main only,
+  never from within NRF24L01DrainRxFifo(), so the buffers are not nested.
+*/
+static void AlarmWait(void)
+{
+  u8_t packet[REPORT_SIZE];
+  
+  __delay_cycles(65536);
+  if (NRF24L01DrainRxFifo(packet, sizeof(packet), ChildPacket))
+    EventPost(EVENT_RECEIVE);
+  ServiceCommands();
 }
 
 static void SystemInit(void)
@@ -58,6 +593,10 @@ static void SystemInit(void)
     
   /* delay for ~65ms (clock is ~1MHz at power-up) for Vcc to stabilize */
   __delay_cycles(65536);
+  
+  /* factory 1MHz DCO calibration, TimerA times the radio and the slots */
+  BCSCTL1 = CALBC1_1MHZ;
+  DCOCTL = CALDCO_1MHZ;
 
   /* setup port 1 */
   P1SEL = BIT5 + BIT6 + BIT7;
@@ -77,6 +616,7 @@ static void SystemInit(void)
   TACCTL0_bit.CCIFG = 0;
   TACCTL0_bit.CCIE = 1;
   TACCTL1_bit.CCIE = 0;
+  EnergyStart(ENERGY_CPU);
   
     /* setup USI */
   USICTL0 |= USIPE5 + USIPE6 + USIPE7 + USIMST + USIOE;
@@ -91,9 +631,12 @@ static void SystemInit(void)
 static void Beep(void)
 {
   u16_t counter = 1000;
+  
+  EnergyStart(ENERGY_BEEP);
   while (counter--)
   {
     __delay_cycles(126);
     PIEZO ^= 1;
   }
+  EnergyStop(ENERGY_BEEP);
 }
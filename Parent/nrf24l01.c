@@ -5,16 +5,39 @@
 
 #include "common.h"
 #include "nrf24l01.h"
+#include "energy.h"
+#include "probe.h"
 
 static u8_t NRF24L01WriteByte(u8_t byte);
-static u8_t NRF24L01ReadByte(void);
+static u8_t NRF24L01Transfer(u8_t cmd, const u8_t *pTx, u8_t *pRx, u8_t numBytes);
+static void NRF24L01CacheRegister(NRF24L01RegAddr_t addr, u8_t byte);
 static u8_t NRF24L01ReadRegister(NRF24L01RegAddr_t addr);
 static void NRF24L01WriteRegister(NRF24L01RegAddr_t addr, u8_t byte);
+static void NRF24L01UpdateRegister(NRF24L01RegAddr_t addr, u8_t byte);
 static u8_t NRF24L01WriteCommand(u8_t cmd);
+static void NRF24L01EnableIrqPin(void);
+static void NRF24L01CompleteSend(NRF24L01TxResult_t result);
+static u8_t NRF24L01WriteFeature(u8_t byte);
+static void NRF24L01UpdateTxStats(void);
 
 #define NRF24L01_IRQ          (P1IN_bit.P1IN_1)
 #define NRF24L01_CE           (P1OUT_bit.P1OUT_3)
 #define NRF24L01_CSN          (P1OUT_bit.P1OUT_2)
+#define NRF24L01_IRQ_BIT      (BIT1)
+
+/* RX-ready notification, set from the IRQ pin interrupt */
+static NRF24L01Callback_t rxCallback = NULL_PTR;
+static bool rxEnabled = FALSE;
+
+/* asynchronous send in progress */
+static NRF24L01TxCallback_t txCallback = NULL_PTR;
+static volatile bool txBusy = FALSE;
+static u8_t txTicks;                /* NRF24L01Tick() calls since the send */
+static NRF24L01TxStats_t txStats;
+
+/* power-up in progress, Tpd2stby counted from pwrStamp */
+static bool pwrStarting = FALSE;
+static u16_t pwrStamp;
 
 /* shadow registers */
 union
@@ -32,6 +55,13 @@ union
     NRF24L01RegStatus_t      regStatus;
     NRF24L01RegObserveTx_t   regObserveTx;
     NRF24L01RegCd_t          regCd;
+    u8_t                     regRxAddrP0;  /* LSByte only */
+    u8_t                     regRxAddrP1;  /* LSByte only */
+    u8_t                     regRxAddrP2;
+    u8_t                     regRxAddrP3;
+    u8_t                     regRxAddrP4;
+    u8_t                     regRxAddrP5;
+    u8_t                     regTxAddr;    /* LSByte only */
     NRF24L01RegRxPwP0_t      regPwP0;
     NRF24L01RegRxPwP1_t      regPwP1;
     NRF24L01RegRxPwP2_t      regPwP2;
@@ -48,94 +78,166 @@ union
   };
 } NRF24L01Regs;
 
+/* registers that change under the chip's control or are not registers */
+#define NRF24L01_REG_UNCACHED   ((1UL << NRF24L01_REG_STATUS) | \
+                                 (1UL << NRF24L01_REG_OBSERVE_TX) | \
+                                 (1UL << NRF24L01_REG_CD) | \
+                                 (1UL << NRF24L01_REG_FIFO_STATUS) | \
+                                 (1UL << NRF24L01_REG_ACK_PLD) | \
+                                 (1UL << NRF24L01_REG_TX_PLD) | \
+                                 (1UL << NRF24L01_REG_RX_PLD) | \
+                                 (1UL << NRF24L01_REG_RESERVED))
+
+/*
+  Configuration profiles, applied in order by NRF24L01Init(). CONFIG
+  goes first so the oscillator starts early, FEATURE before DYNPD.
+  Addresses keep the reset value 0xE7E7E7E7E7, see
+  NRF24L01SetTxAddress(). Both profiles for the PTX end start powered
+  down. Each PTX profile has a PRX one at the same air rate.
+*/
+
+/* PTX, 2Mbps, ACK payloads, 750us between 5 retransmits */
+const NRF24L01Setting_t NRF24L01ProfileLowPowerChild[] =
+{
+  { NRF24L01_REG_CONFIG,     0x0C },  /* EN_CRC, CRCO, PTX, powered down */
+  { NRF24L01_REG_EN_AA,      0x01 },  /* pipe 0 */
+  { NRF24L01_REG_EN_RXADDR,  0x01 },  /* pipe 0, for the ACK */
+  { NRF24L01_REG_SETUP_AW,   0x01 },  /* 3 bytes */
+  { NRF24L01_REG_SETUP_RETR, 0x25 },  /* ARD 750us, ARC 5 */
+  { NRF24L01_REG_RF_CH,      74   },  /* above Wi-Fi channel 11 */
+  { NRF24L01_REG_RF_SETUP,   0x0F },  /* 2Mbps, 0dBm, LNA_HCURR */
+  { NRF24L01_REG_FEATURE,    0x06 },  /* EN_DPL, EN_ACK_PAY */
+  { NRF24L01_REG_DYNPD,      0x01 },  /* pipe 0 */
+  { NRF24L01_PROFILE_END,    0    }
+};
+
+/* PRX, powered up, pipes are opened with NRF24L01EnableRxPipe() */
+const NRF24L01Setting_t NRF24L01ProfileListeningParent[] =
+{
+  { NRF24L01_REG_CONFIG,     0x0F },  /* EN_CRC, CRCO, PRX, PWR_UP */
+  { NRF24L01_REG_EN_AA,      0x01 },
+  { NRF24L01_REG_EN_RXADDR,  0x01 },
+  { NRF24L01_REG_SETUP_AW,   0x01 },
+  { NRF24L01_REG_SETUP_RETR, 0x00 },  /* not used as PRX */
+  { NRF24L01_REG_RF_CH,      74   },
+  { NRF24L01_REG_RF_SETUP,   0x0F },
+  { NRF24L01_REG_FEATURE,    0x06 },
+  { NRF24L01_REG_DYNPD,      0x01 },
+  { NRF24L01_PROFILE_END,    0    }
+};
+
+/* PTX, 1Mbps for sensitivity, longer and more retransmits */
+const NRF24L01Setting_t NRF24L01ProfileLongRange[] =
+{
+  { NRF24L01_REG_CONFIG,     0x0C },
+  { NRF24L01_REG_EN_AA,      0x01 },
+  { NRF24L01_REG_EN_RXADDR,  0x01 },
+  { NRF24L01_REG_SETUP_AW,   0x01 },
+  { NRF24L01_REG_SETUP_RETR, 0x5F },  /* ARD 1500us, ARC 15 */
+  { NRF24L01_REG_RF_CH,      74   },
+  { NRF24L01_REG_RF_SETUP,   0x07 },  /* 1Mbps, 0dBm, LNA_HCURR */
+  { NRF24L01_REG_FEATURE,    0x06 },
+  { NRF24L01_REG_DYNPD,      0x01 },
+  { NRF24L01_PROFILE_END,    0    }
+};
+
+/* PRX for NRF24L01ProfileLongRange, as the listening Parent at 1Mbps */
+const NRF24L01Setting_t NRF24L01ProfileLongRangeParent[] =
+{
+  { NRF24L01_REG_CONFIG,     0x0F },
+  { NRF24L01_REG_EN_AA,      0x01 },
+  { NRF24L01_REG_EN_RXADDR,  0x01 },
+  { NRF24L01_REG_SETUP_AW,   0x01 },
+  { NRF24L01_REG_SETUP_RETR, 0x00 },
+  { NRF24L01_REG_RF_CH,      74   },
+  { NRF24L01_REG_RF_SETUP,   0x07 },  /* 1Mbps, 0dBm, LNA_HCURR */
+  { NRF24L01_REG_FEATURE,    0x06 },
+  { NRF24L01_REG_DYNPD,      0x01 },
+  { NRF24L01_PROFILE_END,    0    }
+};
+
 /*!
- \brief 
+ \brief Load the shadow registers and apply pProfile
+
+ Only registers that differ from the chip are written, followed by one
+ read-back pass.
  */
-u8_t NRF24L01Init(void)
+u8_t NRF24L01Init(const NRF24L01Setting_t *pProfile)
 { 
   u8_t retVal = RET_SUCCESS;
+  NRF24L01RegConfig_t config;
   u8_t i;
   
   NRF24L01_CSN = 1;
   NRF24L01_CE = 0;
 
-  /* read in shadow registers */
+  /* read in shadow registers, skipping the 8 addresses never cached */
+  pwrStarting = FALSE;
   for (i = 0; i < NRF24L01_MAX_REGS; i++)
-    NRF24L01Regs.regArray[i] = NRF24L01ReadRegister((NRF24L01RegAddr_t)i);
-
-  /* CONFIG register setup */
-  NRF24L01Regs.regConfig.byte = 0;
-  NRF24L01Regs.regConfig.bits.MASK_MAX_RT = 1;
-  NRF24L01Regs.regConfig.bits.EN_CRC = 1;
-  NRF24L01Regs.regConfig.bits.CRCO = 1;
-  NRF24L01Regs.regConfig.bits.PRIM_RX = 1;
-  NRF24L01Regs.regConfig.bits.PWR_UP = 1;
-  NRF24L01WriteRegister(NRF24L01_REG_CONFIG, NRF24L01Regs.regConfig.byte);
-  if (NRF24L01ReadRegister(NRF24L01_REG_CONFIG) != NRF24L01Regs.regConfig.byte)
-    retVal |= RET_FAIL;
-  
-  /* wait for power-up, to to Standby-I mode */
-  __delay_cycles(100);
-  
-  /* RETR register setup */
-  NRF24L01Regs.regSetupRetR.byte = 0;  /* 500us + 86us (10 retries) */
-  NRF24L01WriteRegister(NRF24L01_REG_SETUP_RETR, NRF24L01Regs.regSetupRetR.byte);
-  if (NRF24L01ReadRegister(NRF24L01_REG_SETUP_RETR) != NRF24L01Regs.regSetupRetR.byte)
-    retVal |= RET_FAIL;
-
-  /* AW register setup */
-  NRF24L01Regs.regSetupAw.byte = 0;
-  NRF24L01Regs.regSetupAw.bits.AW = 1;
-  NRF24L01WriteRegister(NRF24L01_REG_SETUP_AW, NRF24L01Regs.regSetupAw.byte);
-  if (NRF24L01ReadRegister(NRF24L01_REG_SETUP_AW) != NRF24L01Regs.regSetupAw.byte)
-    retVal |= RET_FAIL;
-
-  /* RF_SETUP register setup */
-  NRF24L01Regs.regRfSetup.byte = 0;
-  NRF24L01Regs.regRfSetup.bits.RF_DR = 1;  /* 2Mbps */
-  NRF24L01Regs.regRfSetup.bits.RF_PWR = 3; /* 0dBm */
-  NRF24L01Regs.regRfSetup.bits.LNA_HCURR = 1;
-  NRF24L01WriteRegister(NRF24L01_REG_RF_SETUP, NRF24L01Regs.regRfSetup.byte);
-  if (NRF24L01ReadRegister(NRF24L01_REG_RF_SETUP) != NRF24L01Regs.regRfSetup.byte)
-    retVal |= RET_FAIL;
-
-  /* RX_PW_P0 register setup */
-  NRF24L01WriteRegister(NRF24L01_REG_RX_PW_P0, 2);
-  if (NRF24L01ReadRegister(NRF24L01_REG_RX_PW_P0) != 2)
-    retVal |= RET_FAIL;
-
-  /* RF_CH register setup */
-  NRF24L01Regs.regRfCh.byte = 0;
-  NRF24L01Regs.regRfCh.bits.RF_CH = 40;
-  NRF24L01WriteRegister(NRF24L01_REG_RF_CH, NRF24L01Regs.regRfCh.byte);
-  if (NRF24L01ReadRegister(NRF24L01_REG_RF_CH) != NRF24L01Regs.regRfCh.byte)
-    retVal |= RET_FAIL;
-
-  /* TX_ADDR register setup */
-  NRF24L01_CSN = 0;
-  NRF24L01WriteByte(NRF24L01_REG_TX_ADDR);
-  NRF24L01WriteByte(0xE7);
-  NRF24L01WriteByte(0xE7);
-  NRF24L01WriteByte(0xE7);
-  NRF24L01WriteByte(0xE7);
-  NRF24L01WriteByte(0xE7);
-  NRF24L01_CSN = 1;
+  {
+    if (!(NRF24L01_REG_UNCACHED & (1UL << i)))
+      NRF24L01Regs.regArray[i] = NRF24L01ReadRegister((NRF24L01RegAddr_t)i);
+  }
 
-  /* EN_AA register setup */
-  NRF24L01Regs.regEnAA.byte = 0;
-  NRF24L01WriteRegister(NRF24L01_REG_EN_AA, NRF24L01Regs.regEnAA.byte);
-  if (NRF24L01ReadRegister(NRF24L01_REG_EN_AA) != NRF24L01Regs.regEnAA.byte)
-    retVal |= RET_FAIL;
-  
+  for (; pProfile->addr != NRF24L01_PROFILE_END; pProfile++)
+  {
+    switch (pProfile->addr)
+    {
+      case NRF24L01_REG_CONFIG:
+        /* power up through NRF24L01PowerUp(), RX/TX wait for Tpd2stby */
+        config.byte = pProfile->value;
+        if (config.bits.PWR_UP)
+        {
+          config.bits.PWR_UP = NRF24L01Regs.regConfig.bits.PWR_UP;
+          NRF24L01UpdateRegister(NRF24L01_REG_CONFIG, config.byte);
+          NRF24L01PowerUp();
+        }
+        else
+          NRF24L01UpdateRegister(NRF24L01_REG_CONFIG, config.byte);
+        break;
+        
+      case NRF24L01_REG_FEATURE:
+        retVal |= NRF24L01WriteFeature(pProfile->value);
+        break;
+        
+      default:
+        NRF24L01UpdateRegister((NRF24L01RegAddr_t)pProfile->addr, pProfile->value);
+        break;
+    }
+  }
   
-//  debug
-//  memset(NRF24L01Regs.regArray, 0, sizeof(NRF24L01Regs.regArray));
-//  for (i = 0; i < NRF24L01_MAX_REGS; i++)
-//    NRF24L01Regs.regArray[i] = NRF24L01ReadRegister(i);
+#if NRF24L01_VERIFY_WRITES
+  /* one read-back pass over the cached registers */
+  retVal |= NRF24L01VerifyRegisters();
+#endif
      
   return retVal;
 }
 
+/*!
+ \brief Read back every cached register
+
+ The read leaves the chip's value in the shadow, so a register that did
+ not match is rewritten by the next update.
+ */
+u8_t NRF24L01VerifyRegisters(void)
+{
+  u8_t retVal = RET_SUCCESS;
+  u8_t i;
+  u8_t expected;
+  
+  for (i = 0; i < NRF24L01_MAX_REGS; i++)
+  {
+    if (!(NRF24L01_REG_UNCACHED & (1UL << i)))
+    {
+      expected = NRF24L01Regs.regArray[i];
+      if (NRF24L01ReadRegister((NRF24L01RegAddr_t)i) != expected)
+        retVal = RET_FAIL;
+    }
+  }
+  
+  return retVal;
+}
 
 /*!
  \brief 
@@ -148,14 +250,45 @@ static u8_t NRF24L01WriteByte(u8_t byte)
   return USISRL;  
 }
 
+/*!
+ \brief Blocking CSN-framed transaction, returns STATUS
+
+ pTx == NULL_PTR clocks out NOP bytes, pRx == NULL_PTR discards MISO.
+ Interrupts stay off, the IRQ ISR uses the bus too. A byte is 16
+ cycles at SMCLK/2, less than a USI interrupt would take to service.
+ */
+static u8_t NRF24L01Transfer(u8_t cmd, const u8_t *pTx, u8_t *pRx, u8_t numBytes)
+{
+  u8_t status;
+  u8_t byte;
+  __istate_t state = __get_interrupt_state();
+  
+  __disable_interrupt();
+  NRF24L01_CSN = 0;
+  status = NRF24L01WriteByte(cmd);
+  while (numBytes--)
+  {
+    byte = NRF24L01WriteByte((pTx != NULL_PTR) ? *pTx++ : NRF24L01_NOP);
+    if (pRx != NULL_PTR)
+      *pRx++ = byte;
+  }
+  NRF24L01_CSN = 1;
+  NRF24L01Regs.regStatus.byte = status;
+  
+  __set_interrupt_state(state);
+  
+  return status;
+}
+
 /*!
  \brief 
  */
-static u8_t NRF24L01ReadByte(void)
+static void NRF24L01CacheRegister(NRF24L01RegAddr_t addr, u8_t byte)
 {
-  USICNT = 8;
-  while (!(USICTL1 & USIIFG)); 
-  return USISRL;
+  if (NRF24L01_REG_UNCACHED & (1UL << addr))
+    return;
+  
+  NRF24L01Regs.regArray[addr] = byte;
 }
 
 /*!
@@ -165,50 +298,121 @@ static u8_t NRF24L01ReadRegister(NRF24L01RegAddr_t addr)
 {
   u8_t retByte;
   
-  NRF24L01_CSN = 0;
-  NRF24L01WriteByte(NRF24L01_READ_REG | addr);
-  retByte = NRF24L01ReadByte();
-  NRF24L01_CSN = 1;
+  NRF24L01ReadRegisters(addr, &retByte, 1);
   
   return retByte;
 }
 
 /*!
- \brief 
+ \brief Write-through, always goes to the chip
  */
 static void NRF24L01WriteRegister(NRF24L01RegAddr_t addr, u8_t byte)
 {
-  NRF24L01_CSN = 0;
-  NRF24L01WriteByte(NRF24L01_WRITE_REG | addr);
-  NRF24L01WriteByte(byte);
-  NRF24L01_CSN = 1;
+  NRF24L01WriteRegisters(addr, &byte, 1);
 }
 
 /*!
- \brief 
+ \brief Burst read of a multi-byte register in one transaction
+
+ Address registers are LSByte first, single byte registers use
+ numBytes = 1.
  */
-static u8_t NRF24L01WriteCommand(u8_t cmd)
+u8_t NRF24L01ReadRegisters(NRF24L01RegAddr_t addr, u8_t *pBuf, u8_t numBytes)
 {
-  u8_t retByte;
+  if ((numBytes == 0) || (numBytes > NRF24L01_MAX_ADDR_WIDTH))
+    return RET_FAIL;
   
-  NRF24L01_CSN = 0;
-  retByte = NRF24L01WriteByte(cmd);  
-  NRF24L01_CSN = 1;
+  NRF24L01Transfer(NRF24L01_READ_REG | addr, NULL_PTR, pBuf, numBytes);
+  NRF24L01CacheRegister(addr, pBuf[0]);
   
-  return retByte;
+  return RET_SUCCESS;
 }
 
 /*!
- \brief 
+ \brief Burst write of a multi-byte register in one transaction
  */
-u8_t NRF24L01StartTransmitMode(void)
-{ 
-  /* clear all interrupt flags */
-	NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_ALL);
+u8_t NRF24L01WriteRegisters(NRF24L01RegAddr_t addr, const u8_t *pBuf, u8_t numBytes)
+{
+  if ((numBytes == 0) || (numBytes > NRF24L01_MAX_ADDR_WIDTH))
+    return RET_FAIL;
+  
+  NRF24L01Transfer(NRF24L01_WRITE_REG | addr, pBuf, NULL_PTR, numBytes);
+  NRF24L01CacheRegister(addr, pBuf[0]);
+  
+  /* STATUS came back before the write, interrupt flags are cleared by 1 */
+  if (addr == NRF24L01_REG_STATUS)
+  {
+    NRF24L01Regs.regStatus.byte &= ~(pBuf[0] & NRF24L01_INT_ALL);
+    
+    /* the pin interrupt is edge triggered, re-arm if flags are left */
+    if ((P1IE & NRF24L01_IRQ_BIT) && (NRF24L01_IRQ == 0))
+      P1IFG |= NRF24L01_IRQ_BIT;
+  }
+  
+  return RET_SUCCESS;
+}
 
-  /* Go into TX mode */
-  NRF24L01Regs.regConfig.bits.PRIM_RX = 0;
-  NRF24L01WriteRegister(NRF24L01_REG_CONFIG, NRF24L01Regs.regConfig.byte);
+/*!
+ \brief Address width in bytes, from SETUP_AW
+ */
+u8_t NRF24L01GetAddressWidth(void)
+{
+  return NRF24L01Regs.regSetupAw.bits.AW + 2;
+}
+
+/*!
+ \brief Write TX_ADDR, pAddr holds address width bytes LSByte first
+ */
+u8_t NRF24L01SetTxAddress(const u8_t *pAddr)
+{
+  return NRF24L01WriteRegisters(NRF24L01_REG_TX_ADDR, pAddr, NRF24L01GetAddressWidth());
+}
+
+/*!
+ \brief Write RX_ADDR_Px
+
+ Pipes 0 and 1 take the full address, pipes 2..5 only differ from
+ pipe 1 in the LSByte and use pAddr[0].
+ */
+u8_t NRF24L01SetRxAddress(u8_t pipe, const u8_t *pAddr)
+{
+  NRF24L01RegAddr_t addr = (NRF24L01RegAddr_t)(NRF24L01_REG_RX_ADDR_PO + pipe);
+  
+  if (pipe >= NRF24L01_MAX_PIPES)
+    return RET_FAIL;
+  
+  if (pipe > 1)
+  {
+    NRF24L01UpdateRegister(addr, pAddr[0]);
+    return RET_SUCCESS;
+  }
+  
+  return NRF24L01WriteRegisters(addr, pAddr, NRF24L01GetAddressWidth());
+}
+
+/*!
+ \brief Open an RX pipe on pAddr
+
+ width is the static payload width, 0 selects dynamic payload length.
+ See NRF24L01SetRxAddress() for the address sharing of pipes 2..5.
+ */
+u8_t NRF24L01EnableRxPipe(u8_t pipe, const u8_t *pAddr, u8_t width)
+{
+  if ((pipe >= NRF24L01_MAX_PIPES) || (width > NRF24L01_MAX_PAYLOAD_SIZE))
+    return RET_FAIL;
+  
+  NRF24L01SetRxAddress(pipe, pAddr);
+  if (width == 0)
+  {
+    if (NRF24L01EnableDynamicPayload(NRF24L01_PIPE(pipe)) != RET_SUCCESS)
+      return RET_FAIL;
+  }
+  else
+  {
+    NRF24L01UpdateRegister(NRF24L01_REG_DYNPD, NRF24L01Regs.regDynPd.byte & ~NRF24L01_PIPE(pipe));
+    NRF24L01UpdateRegister((NRF24L01RegAddr_t)(NRF24L01_REG_RX_PW_P0 + pipe), width);
+  }
+  NRF24L01UpdateRegister(NRF24L01_REG_EN_RXADDR, NRF24L01Regs.regEnRxAddr.byte | NRF24L01_PIPE(pipe));
   
   return RET_SUCCESS;
 }
@@ -216,29 +420,63 @@ u8_t NRF24L01StartTransmitMode(void)
 /*!
  \brief 
  */
-bool NRF24L01IsPacketTransmitted(void)
+u8_t NRF24L01DisableRxPipe(u8_t pipe)
+{
+  if (pipe >= NRF24L01_MAX_PIPES)
+    return RET_FAIL;
+  
+  NRF24L01UpdateRegister(NRF24L01_REG_EN_RXADDR, NRF24L01Regs.regEnRxAddr.byte & ~NRF24L01_PIPE(pipe));
+  
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief Write only if the cached value differs
+ */
+static void NRF24L01UpdateRegister(NRF24L01RegAddr_t addr, u8_t byte)
+{
+  if (!(NRF24L01_REG_UNCACHED & (1UL << addr)) && (NRF24L01Regs.regArray[addr] == byte))
+    return;
+  
+  NRF24L01WriteRegister(addr, byte);
+}
+
+/*!
+ \brief 
+ */
+static u8_t NRF24L01WriteCommand(u8_t cmd)
+{
+  return NRF24L01Transfer(cmd, NULL_PTR, NULL_PTR, 0);
+}
+
+/*!
+ \brief 
+ */
+u8_t NRF24L01StartTransmitMode(void)
 { 
-  bool rcvd;
+  NRF24L01RegConfig_t config;
   
-  rcvd = NRF24L01WriteCommand(NRF24L01_NOP) & NRF24L01_INT_TX_DS;
+  /* clear all interrupt flags */
+	NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_ALL);
+
+  /* Go into TX mode */
+  config = NRF24L01Regs.regConfig;
+  config.bits.PRIM_RX = 0;
+  NRF24L01UpdateRegister(NRF24L01_REG_CONFIG, config.byte);
   
-  return rcvd ? TRUE: FALSE;
+  return RET_SUCCESS;
 }
 
 /*!
  \brief 
  */
-u8_t NRF24L01WriteFifo(u8_t *pPacket, u8_t numBytes)
+u8_t NRF24L01WriteFifo(const u8_t *pPacket, u8_t numBytes)
 {
   /* flush transmit FIFO */
   NRF24L01WriteCommand(NRF24L01_FLUSH_TX);
   
   /* write payload to FIFO */
-  NRF24L01_CSN = 0;
-  NRF24L01WriteByte(NRF24L01_WR_TX_PLOAD);
-  while (numBytes--)
-    NRF24L01WriteByte(*pPacket++);
-  NRF24L01_CSN = 1;
+  NRF24L01Transfer(NRF24L01_WR_TX_PLOAD, pPacket, NULL_PTR, numBytes);
     
   return RET_SUCCESS;
 }
@@ -248,72 +486,128 @@ u8_t NRF24L01WriteFifo(u8_t *pPacket, u8_t numBytes)
  */
 u8_t NRF24L01InitiateTransmit(void)
 { 
+  NRF24L01WaitPowerUp();
+  
   /* initiate TX */
   NRF24L01_CE = 1;
   __delay_cycles(10);
   NRF24L01_CE = 0;
+  EnergyStart(ENERGY_RADIO_TX);
   
   return RET_SUCCESS;
 }
 
 /*!
- \brief 
+ \brief Submit a packet and return, pDone reports the outcome
+
+ The payload is copied into the TX FIFO before returning. pDone is
+ invoked from interrupt context with NRF24L01_TX_SENT on TX_DS,
+ NRF24L01_TX_FAILED on MAX_RT or NRF24L01_TX_TIMEOUT when neither
+ arrived by the NRF24L01_TX_TIMEOUT_TICKS-th NRF24L01Tick().
  */
-u8_t NRF24L01EndTransmitMode(void)
-{ 
-  /* clear data sent (DS) interrupt */
-  NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_TX_DS);
+u8_t NRF24L01SendPacketAsync(const u8_t *pPacket, u8_t numBytes, NRF24L01TxCallback_t pDone)
+{
+  __istate_t state = __get_interrupt_state();
+  
+  __disable_interrupt();
+  if (txBusy)
+  {
+    __set_interrupt_state(state);
+    return RET_FAIL;
+  }
+  txBusy = TRUE;
+  txCallback = pDone;
+  txTicks = 0;
+  __set_interrupt_state(state);
+  
+  ProbeEnter(PROBE_SEND);
+  NRF24L01StartTransmitMode();
+  NRF24L01WriteFifo(pPacket, numBytes);
+  NRF24L01EnableIrqPin();
+  NRF24L01InitiateTransmit();
+  ProbeExit(PROBE_SEND);
   
   return RET_SUCCESS;
 }
 
 /*!
- \brief 
+ \brief Timeout supervision, call periodically from a timer ISR
+
+ Counts calls rather than TAR, which may wrap more than once in a
+ period. Returns TRUE when it completed a send, the ISR should then
+ wake main for what pDone posted.
  */
-u8_t NRF24L01SendPacket(u8_t *pPacket, u8_t numBytes)
+bool NRF24L01Tick(void)
 {
-  u8_t retVal = RET_SUCCESS;
+  if (!txBusy || (++txTicks < NRF24L01_TX_TIMEOUT_TICKS))
+    return FALSE;
   
-  /* clear all interrupt flags */
-	NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_ALL);
+  NRF24L01CompleteSend(NRF24L01_TX_TIMEOUT);
+  return TRUE;
+}
 
-  /* Go into TX mode */
-  NRF24L01Regs.regConfig.bits.PRIM_RX = 0;
-  NRF24L01WriteRegister(NRF24L01_REG_CONFIG, NRF24L01Regs.regConfig.byte);
+/*!
+ \brief Tune to channel, CE is dropped around the change
 
-  /* flush transmit FIFO */
-  NRF24L01WriteCommand(NRF24L01_FLUSH_TX);
+ Resets OBSERVE_TX.PLOS_CNT.
+ */
+u8_t NRF24L01SetChannel(u8_t channel)
+{
+  u8_t ce = NRF24L01_CE;
   
-  /* write payload to FIFO */
-  NRF24L01_CSN = 0;
-  NRF24L01WriteByte(NRF24L01_WR_TX_PLOAD);
-  while (numBytes--)
-    NRF24L01WriteByte(*pPacket++);
-  NRF24L01_CSN = 1;
+  if (channel > NRF24L01_MAX_CHANNEL)
+    return RET_FAIL;
   
-  /* initiate TX */
-  NRF24L01_CE = 1;
-  __delay_cycles(10);
   NRF24L01_CE = 0;
+  NRF24L01UpdateRegister(NRF24L01_REG_RF_CH, channel);
+  NRF24L01_CE = ce;
   
-  /* wait until TX done */
-  while ((NRF24L01WriteCommand(NRF24L01_NOP) & NRF24L01_INT_TX_DS) == 0) { };
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief Output power, NRF24L01_TX_POWER_xxx, applies from the next packet
+ */
+u8_t NRF24L01SetTxPower(u8_t level)
+{
+  NRF24L01RegRfSetup_t rfSetup;
   
-  /* clear data sent (DS) interrupt */
-  NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_TX_DS);
+  if (level > NRF24L01_TX_POWER_0DBM)
+    return RET_FAIL;
   
-  return retVal;
+  rfSetup = NRF24L01Regs.regRfSetup;
+  rfSetup.bits.RF_PWR = level;
+  NRF24L01UpdateRegister(NRF24L01_REG_RF_SETUP, rfSetup.byte);
+  
+  return RET_SUCCESS;
 }
 
 /*!
  \brief 
  */
-u8_t NRF24L01StartReceiveMode(void)
-{ 
-  /* Go into RX mode */
-  NRF24L01Regs.regConfig.bits.PRIM_RX = 1;
-  NRF24L01WriteRegister(NRF24L01_REG_CONFIG, NRF24L01Regs.regConfig.byte);
-  NRF24L01_CE = 1;
+u8_t NRF24L01GetTxPower(void)
+{
+  return NRF24L01Regs.regRfSetup.bits.RF_PWR;
+}
+
+/*!
+ \brief Air data rate, NRF24L01_DATA_RATE_xxx, CE is dropped around the change
+
+ Both ends of a link must use the same rate.
+ */
+u8_t NRF24L01SetDataRate(u8_t rate)
+{
+  NRF24L01RegRfSetup_t rfSetup;
+  u8_t ce = NRF24L01_CE;
+  
+  if (rate > NRF24L01_DATA_RATE_2MBPS)
+    return RET_FAIL;
+  
+  rfSetup = NRF24L01Regs.regRfSetup;
+  rfSetup.bits.RF_DR = rate;
+  NRF24L01_CE = 0;
+  NRF24L01UpdateRegister(NRF24L01_REG_RF_SETUP, rfSetup.byte);
+  NRF24L01_CE = ce;
   
   return RET_SUCCESS;
 }
@@ -321,30 +615,202 @@ u8_t NRF24L01StartReceiveMode(void)
 /*!
  \brief 
  */
-u8_t NRF24L01EndReceiveMode(void)
-{ 
-  /* get out of RX mode */
+u8_t NRF24L01GetDataRate(void)
+{
+  return NRF24L01Regs.regRfSetup.bits.RF_DR;
+}
+
+/*!
+ \brief Carrier detect hits out of samples on the current channel
+
+ Only meaningful in RX mode, CE high for at least NRF24L01_CD_SETTLE_US.
+ */
+u8_t NRF24L01ReadCarrier(u8_t samples)
+{
+  NRF24L01RegCd_t cd;
+  u8_t hits = 0;
+  
+  while (samples--)
+  {
+    cd.byte = NRF24L01ReadRegister(NRF24L01_REG_CD);
+    if (cd.bits.CD)
+      hits++;
+  }
+  
+  return hits;
+}
+
+/*!
+ \brief Listen on channel and count carrier detect hits out of samples
+
+ Needs PRIM_RX and PWR_UP. The chip is left tuned to channel, with CE as
+ it was found.
+ */
+u8_t NRF24L01SurveyChannel(u8_t channel, u8_t samples)
+{
+  u8_t ce = NRF24L01_CE;
+  u16_t stamp;
+  u8_t hits;
+  
+  if (channel > NRF24L01_MAX_CHANNEL)
+    return 0;
+  
+  NRF24L01WaitPowerUp();
   NRF24L01_CE = 0;
+  NRF24L01SetChannel(channel);
+  NRF24L01_CE = 1;
+  EnergyStart(ENERGY_RADIO_RX);
+  stamp = TAR;
+  while ((u16_t)(TAR - stamp) < NRF24L01_US_TO_TICKS(NRF24L01_CD_SETTLE_US));
+  hits = NRF24L01ReadCarrier(samples);
+  NRF24L01_CE = ce;
+  if (!ce)
+    EnergyStop(ENERGY_RADIO_RX);
   
-    /* flush receive FIFO */
-  NRF24L01WriteCommand(NRF24L01_FLUSH_RX);
+  return hits;
+}
 
-  /* clear data received (DR) interrupt */
-  NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_RX_DR);
+/*!
+ \brief FIFO_STATUS, NRF24L01_FIFO_STATUS_xxx flags
+ */
+u8_t NRF24L01ReadFifoStatus(void)
+{
+  return NRF24L01ReadRegister(NRF24L01_REG_FIFO_STATUS);
+}
+
+/*!
+ \brief Delivery statistics, see NRF24L01TxStats_t
+ */
+const NRF24L01TxStats_t *NRF24L01GetTxStats(void)
+{
+  return &txStats;
+}
+
+/*!
+ \brief Account for a finished send, OBSERVE_TX only with auto-ack
+ */
+static void NRF24L01UpdateTxStats(void)
+{
+  NRF24L01RegObserveTx_t observeTx;
+  
+  if (!(NRF24L01Regs.regEnAA.byte & NRF24L01_PIPE(0)))
+    return;
+  
+  observeTx.byte = NRF24L01ReadRegister(NRF24L01_REG_OBSERVE_TX);
+  txStats.lastRetransmits = observeTx.bits.ARC_CNT;
+  txStats.lost = observeTx.bits.PLOS_CNT;
+}
+
+/*!
+ \brief Enter Power Down, registers are kept
+
+ Fails while an asynchronous send is in progress.
+ */
+u8_t NRF24L01PowerDown(void)
+{
+  NRF24L01RegConfig_t config;
+  
+  if (txBusy)
+    return RET_FAIL;
+  
+  NRF24L01_CE = 0;
+  config = NRF24L01Regs.regConfig;
+  config.bits.PWR_UP = 0;
+  NRF24L01UpdateRegister(NRF24L01_REG_CONFIG, config.byte);
+  pwrStarting = FALSE;
+  EnergyStop(ENERGY_RADIO_RX);
+  EnergyStop(ENERGY_RADIO_ON);
+  
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief Start the crystal oscillator and return
+
+ The radio reaches Standby-I NRF24L01_TPD2STBY_US later, RX and TX wait
+ for that on their own. Call this early to overlap the start-up with
+ other work.
+ */
+u8_t NRF24L01PowerUp(void)
+{
+  NRF24L01RegConfig_t config;
+  
+  if (NRF24L01Regs.regConfig.bits.PWR_UP)
+    return RET_SUCCESS;
+  
+  config = NRF24L01Regs.regConfig;
+  config.bits.PWR_UP = 1;
+  NRF24L01UpdateRegister(NRF24L01_REG_CONFIG, config.byte);
+  pwrStamp = TAR;
+  pwrStarting = TRUE;
+  EnergyStart(ENERGY_RADIO_ON);
   
   return RET_SUCCESS;
 }
 
+/*!
+ \brief TRUE once the radio is in Standby-I
+ */
+bool NRF24L01IsPoweredUp(void)
+{
+  if (!NRF24L01Regs.regConfig.bits.PWR_UP)
+    return FALSE;
+  
+  if (pwrStarting)
+  {
+    if ((u16_t)(TAR - pwrStamp) < NRF24L01_US_TO_TICKS(NRF24L01_TPD2STBY_US))
+      return FALSE;
+    pwrStarting = FALSE;
+  }
+  
+  return TRUE;
+}
+
+/*!
+ \brief Power up if needed and wait out the rest of Tpd2stby
+ */
+void NRF24L01WaitPowerUp(void)
+{
+  NRF24L01PowerUp();
+  while (!NRF24L01IsPoweredUp()) { };
+}
+
 /*!
  \brief 
  */
-bool NRF24L01IsPacketReceived(void)
+static void NRF24L01CompleteSend(NRF24L01TxResult_t result)
+{
+  NRF24L01TxCallback_t pDone = txCallback;
+  
+  NRF24L01_CE = 0;
+  EnergyStop(ENERGY_RADIO_TX);
+  if (result != NRF24L01_TX_SENT)
+    NRF24L01WriteCommand(NRF24L01_FLUSH_TX);
+  NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_TX_DS | NRF24L01_INT_MAX_RT);
+  NRF24L01UpdateTxStats();
+  
+  txCallback = NULL_PTR;
+  txBusy = FALSE;
+  if (pDone != NULL_PTR)
+    pDone(result);
+}
+
+/*!
+ \brief 
+ */
+u8_t NRF24L01StartReceiveMode(void)
 { 
-  bool rcvd;
+  NRF24L01RegConfig_t config;
   
-  rcvd = NRF24L01WriteCommand(NRF24L01_NOP) & NRF24L01_INT_RX_DR;
+  /* Go into RX mode */
+  config = NRF24L01Regs.regConfig;
+  config.bits.PRIM_RX = 1;
+  NRF24L01UpdateRegister(NRF24L01_REG_CONFIG, config.byte);
+  NRF24L01WaitPowerUp();
+  NRF24L01_CE = 1;
+  EnergyStart(ENERGY_RADIO_RX);
   
-  return rcvd ? TRUE: FALSE;
+  return RET_SUCCESS;
 }
 
 /*!
@@ -352,56 +818,233 @@ bool NRF24L01IsPacketReceived(void)
  */
 u8_t NRF24L01ReadFifo(u8_t *pPacket, u8_t maxBytes)
 {
-  u8_t numBytes = 0;
+  u8_t numBytes = maxBytes;
+  u8_t pipe = NRF24L01Regs.regStatus.bits.RX_P_NO;
   
-  /* read payload from FIFO */
-  NRF24L01_CSN = 0;
-  NRF24L01WriteByte(NRF24L01_RD_RX_PLOAD);
-  while (maxBytes--)
+  /* dynamic payload pipe, read exactly what was sent */
+  if (NRF24L01Regs.regFeature.bits.EN_DPL &&
+      (pipe < NRF24L01_MAX_PIPES) && (NRF24L01Regs.regDynPd.byte & NRF24L01_PIPE(pipe)))
   {
-    *pPacket++ = NRF24L01ReadByte();
-    numBytes++;
+    numBytes = NRF24L01ReadPayloadWidth();
+    if (numBytes > maxBytes)
+      numBytes = maxBytes;
+    if (numBytes == 0)
+      return 0;
   }
-  NRF24L01_CSN = 1;
+  else if (pipe < NRF24L01_MAX_PIPES)
+  {
+    numBytes = NRF24L01Regs.regArray[NRF24L01_REG_RX_PW_P0 + pipe];
+    if (numBytes > maxBytes)
+      numBytes = maxBytes;
+  }
+  
+  /* read payload from FIFO */
+  NRF24L01Transfer(NRF24L01_RD_RX_PLOAD, NULL_PTR, pPacket, numBytes);
     
   return numBytes;
 }
 
-
 /*!
- \brief 
+ \brief Hand every packet in the RX FIFO to pHandler, staying in RX mode
+
+ Each packet is read into pBuffer, cut to maxBytes, so the caller sizes
+ it to the longest packet it expects rather than the 32-byte FIFO.
+ RX_DR is cleared before the FIFO is emptied, so a packet arriving
+ meanwhile raises the IRQ again instead of waiting for the next one.
+ Returns the number of packets drained.
  */
-u8_t NRF24L01ReceivePacket(u8_t *pPacket, u8_t maxBytes)
+u8_t NRF24L01DrainRxFifo(u8_t *pBuffer, u8_t maxBytes, NRF24L01RxHandler_t pHandler)
 {
-  u8_t numBytes = 0;
+  u8_t numPackets = 0;
+  u8_t numBytes;
+  u8_t pipe;
+  
+  NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_RX_DR);
+  
+  while (!(NRF24L01ReadRegister(NRF24L01_REG_FIFO_STATUS) & NRF24L01_FIFO_STATUS_RX_EMPTY))
+  {
+    /* STATUS came in with FIFO_STATUS */
+    pipe = NRF24L01Regs.regStatus.bits.RX_P_NO;
+    numBytes = NRF24L01ReadFifo(pBuffer, maxBytes);
+    numPackets++;
     
-  /* Go into RX mode */
-  NRF24L01Regs.regConfig.bits.PRIM_RX = 1;
-  NRF24L01WriteRegister(NRF24L01_REG_CONFIG, NRF24L01Regs.regConfig.byte);
-  NRF24L01_CE = 1;
+    /* a corrupt packet was flushed along with the rest */
+    if (numBytes == 0)
+      break;
+    
+    if (pHandler != NULL_PTR)
+      pHandler(pipe, pBuffer, numBytes);
+  }
+  
+  return numPackets;
+}
 
-  /* wait until packet received */
-  while ((NRF24L01WriteCommand(NRF24L01_NOP) & NRF24L01_INT_RX_DR) == 0) { };
+/*!
+ \brief Width of the payload at the head of the RX FIFO
 
-  /* read payload from FIFO */
-  NRF24L01_CSN = 0;
-  NRF24L01WriteByte(NRF24L01_RD_RX_PLOAD);
-  while (maxBytes--)
+ A width above 32 means a corrupt packet, the FIFO is flushed and 0 is
+ returned.
+ */
+u8_t NRF24L01ReadPayloadWidth(void)
+{
+  u8_t width;
+  
+  NRF24L01Transfer(NRF24L01_R_RX_PL_WID, NULL_PTR, &width, 1);
+  if (width > NRF24L01_MAX_PAYLOAD_SIZE)
   {
-    *pPacket++ = NRF24L01ReadByte();
-    numBytes++;
+    NRF24L01WriteCommand(NRF24L01_FLUSH_RX);
+    width = 0;
   }
-  NRF24L01_CSN = 1;
+  
+  return width;
+}
 
-  /* flush receive FIFO */
-  NRF24L01WriteCommand(NRF24L01_FLUSH_RX);
+/*!
+ \brief Enable dynamic payload length on the pipes in pipeMask
 
-  /* clear data received (DR) interrupt */
-  NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_RX_DR);
+ FEATURE and DYNPD only respond after ACTIVATE, which toggles, so it is
+ only sent when a FEATURE write did not stick. DPL needs auto-ack, the
+ pipes are added to EN_AA.
+ */
+u8_t NRF24L01EnableDynamicPayload(u8_t pipeMask)
+{
+  NRF24L01RegFeature_t feature;
   
-  /* get out of RX mode */
-  NRF24L01_CE = 0;
+  feature = NRF24L01Regs.regFeature;
+  feature.bits.EN_DPL = 1;
+  if (NRF24L01WriteFeature(feature.byte) != RET_SUCCESS)
+    return RET_FAIL;
+  
+  NRF24L01UpdateRegister(NRF24L01_REG_EN_AA, NRF24L01Regs.regEnAA.byte | pipeMask);
+  NRF24L01UpdateRegister(NRF24L01_REG_DYNPD, NRF24L01Regs.regDynPd.byte | pipeMask);
+  
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief Write FEATURE, unlocking it with ACTIVATE if needed
+
+ ACTIVATE toggles, so it is only sent when the write did not stick.
+ */
+static u8_t NRF24L01WriteFeature(u8_t byte)
+{
+  static const u8_t key = NRF24L01_ACTIVATE_KEY;
+  
+  NRF24L01UpdateRegister(NRF24L01_REG_FEATURE, byte);
+  if (NRF24L01ReadRegister(NRF24L01_REG_FEATURE) != byte)
+  {
+    NRF24L01Transfer(NRF24L01_ACTIVATE, &key, NULL_PTR, 1);
+    NRF24L01WriteRegister(NRF24L01_REG_FEATURE, byte);
+    if (NRF24L01ReadRegister(NRF24L01_REG_FEATURE) != byte)
+      return RET_FAIL;
+  }
+  
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief PRX, queue a payload for the next ACK on pipe
+
+ Up to three payloads can wait in the TX FIFO.
+ */
+u8_t NRF24L01WriteAckPayload(u8_t pipe, const u8_t *pPayload, u8_t numBytes)
+{
+  if ((pipe >= NRF24L01_MAX_PIPES) || (numBytes == 0) || (numBytes > NRF24L01_MAX_PAYLOAD_SIZE))
+    return RET_FAIL;
+  
+  NRF24L01Transfer(NRF24L01_W_ACK_PAYLOAD | pipe, pPayload, NULL_PTR, numBytes);
+  
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief PRX, drop ACK payloads that have not been sent
+ */
+u8_t NRF24L01FlushAckPayloads(void)
+{
+  NRF24L01WriteCommand(NRF24L01_FLUSH_TX);
+  
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief PTX, fetch the payload that came back with the last ACK
+
+ Call after NRF24L01_TX_SENT, returns 0 if the ACK was empty.
+ */
+u8_t NRF24L01ReadAckPayload(u8_t *pPayload, u8_t maxBytes)
+{
+  u8_t numBytes;
+  
+  if (!(NRF24L01Regs.regStatus.byte & NRF24L01_INT_RX_DR))
+    return 0;
+  
+  numBytes = NRF24L01ReadFifo(pPayload, maxBytes);
+  NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_RX_DR);
   
   return numBytes;
 }
 
+/*!
+ \brief Enable the IRQ pin interrupt and notify on RX_DR
+
+ pCallback is invoked from interrupt context when a packet is received.
+ */
+u8_t NRF24L01EnableRxInterrupt(NRF24L01Callback_t pCallback)
+{
+  rxCallback = pCallback;
+  rxEnabled = TRUE;
+  NRF24L01EnableIrqPin();
+
+  return RET_SUCCESS;
+}
+
+/*!
+ \brief 
+ */
+static void NRF24L01EnableIrqPin(void)
+{
+  if (P1IE & NRF24L01_IRQ_BIT)
+    return;
+  
+  /* IRQ is active low, interrupt on falling edge */
+  P1DIR &= ~NRF24L01_IRQ_BIT;
+  P1IES |= NRF24L01_IRQ_BIT;
+  P1IFG &= ~NRF24L01_IRQ_BIT;
+  P1IE |= NRF24L01_IRQ_BIT;
+
+  /* edge already missed, event pending */
+  if (NRF24L01_IRQ == 0)
+    P1IFG |= NRF24L01_IRQ_BIT;
+}
+
+#pragma vector = PORT1_VECTOR
+__interrupt void NRF24L01IrqHandler(void)
+{
+  u8_t status;
+  
+  ProbeEnter(PROBE_RADIO_ISR);
+  if (P1IFG & NRF24L01_IRQ_BIT)
+  {
+    P1IFG &= ~NRF24L01_IRQ_BIT;
+    status = NRF24L01WriteCommand(NRF24L01_NOP);
+    
+    if (txBusy && (status & (NRF24L01_INT_TX_DS | NRF24L01_INT_MAX_RT)))
+      NRF24L01CompleteSend((status & NRF24L01_INT_TX_DS) ? NRF24L01_TX_SENT : NRF24L01_TX_FAILED);
+    else if (status & NRF24L01_INT_TX_DS)
+    {
+      /* PRX, an ACK payload went out, its child's next packet says so */
+      NRF24L01WriteRegister(NRF24L01_REG_STATUS, NRF24L01_INT_TX_DS);
+    }
+    
+    if (rxEnabled && (status & NRF24L01_INT_RX_DR))
+    {
+      if (rxCallback != NULL_PTR)
+        rxCallback();
+    }
+    
+    /* let main pick up whatever the callbacks posted */
+    __low_power_mode_off_on_exit();
+  }
+  ProbeExit(PROBE_RADIO_ISR);
+}
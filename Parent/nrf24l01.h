@@ -6,6 +6,47 @@
 
 #define NRF24L01_MAX_PAYLOAD_SIZE    (32)
 #define NRF24L01_MAX_REGS            (0x1E)
+#define NRF24L01_MAX_ADDR_WIDTH      (5)
+#define NRF24L01_MAX_PIPES           (6)
+#define NRF24L01_TX_FIFO_DEPTH       (3)
+#define NRF24L01_RX_PIPE_EMPTY       (7)     /* STATUS.RX_P_NO, RX FIFO empty */
+#define NRF24L01_MAX_CHANNEL         (125)   /* 2400 + RF_CH MHz */
+
+/* TimerA runs continuously from SMCLK/8 on both boards */
+#ifndef NRF24L01_TIMER_US_PER_TICK
+#define NRF24L01_TIMER_US_PER_TICK   (8)
+#endif
+#define NRF24L01_US_TO_TICKS(us)     ((u16_t)(((us) + NRF24L01_TIMER_US_PER_TICK - 1) / \
+                                              NRF24L01_TIMER_US_PER_TICK))
+
+/* longest a send may take, must cover ARC x ARD */
+#ifndef NRF24L01_TX_TIMEOUT_US
+#define NRF24L01_TX_TIMEOUT_US       (100000UL)
+#endif
+
+/* the same for NRF24L01SendPacketAsync(), in NRF24L01Tick() calls, the first may come at once */
+#ifndef NRF24L01_TX_TIMEOUT_TICKS
+#define NRF24L01_TX_TIMEOUT_TICKS    (2)
+#endif
+
+/*
+  Tpd2stby, Power Down to Standby-I, 1.5ms worst case for the crystal.
+  Timed in TAR ticks off the DCO, which even calibrated is only good to
+  a few percent, hence a third more.
+*/
+#ifndef NRF24L01_TPD2STBY_US
+#define NRF24L01_TPD2STBY_US         (2000)
+#endif
+
+/* Tstby2a plus the 128us CD needs to settle after RX starts */
+#ifndef NRF24L01_CD_SETTLE_US
+#define NRF24L01_CD_SETTLE_US        (260)
+#endif
+
+/* read back registers once at the end of NRF24L01Init() */
+#ifndef NRF24L01_VERIFY_WRITES
+#define NRF24L01_VERIFY_WRITES       (1)
+#endif
 
 /* Interrupt flags */
 #define NRF24L01_INT_IDLE        (0x00)  /* Idle, no interrupt pending */
@@ -30,6 +71,22 @@
 #define NRF24L01_W_TX_PAYLOAD_NOACK  (0xB0)  /* Disable ACK with this packet */
 #define NRF24L01_NOP                 (0xFF)  /* No operation */
 
+#define NRF24L01_ACTIVATE_KEY        (0x73)  /* ACTIVATE data, unlocks FEATURE */
+
+#define NRF24L01_PIPE(n)             (1 << (n))  /* EN_AA/EN_RXADDR/DYNPD bit */
+
+#define NRF24L01_ARD_US(us)          (((us) / 250) - 1)  /* SETUP_RETR.ARD, 250..4000 */
+
+/* RF_SETUP.RF_PWR */
+#define NRF24L01_TX_POWER_M18DBM     (0)     /* 7.0mA */
+#define NRF24L01_TX_POWER_M12DBM     (1)     /* 7.5mA */
+#define NRF24L01_TX_POWER_M6DBM      (2)     /* 9.0mA */
+#define NRF24L01_TX_POWER_0DBM       (3)     /* 11.3mA */
+
+/* RF_SETUP.RF_DR */
+#define NRF24L01_DATA_RATE_1MBPS     (0)     /* better sensitivity, range */
+#define NRF24L01_DATA_RATE_2MBPS     (1)     /* half the time on air */
+
 /* register addresses */
 typedef enum
 {
@@ -173,8 +230,8 @@ typedef union
 {
   struct
   {
-    u8_t ARC_CNT      : 4;  /* Count of lost packets */
-    u8_t PLOS_CNT     : 4;  /* Count of retransmitted packets */
+    u8_t ARC_CNT      : 4;  /* Count of retransmitted packets */
+    u8_t PLOS_CNT     : 4;  /* Count of lost packets */
   } bits;
   u8_t byte;
 } NRF24L01RegObserveTx_t;
@@ -193,8 +250,8 @@ typedef union
 {
   struct
   {
-    u8_t RX_PW_PO     : 1;  /* Num bytes in data pipe 0 */
-    u8_t reserved     : 7;  
+    u8_t RX_PW_PO     : 6;  /* Num bytes in data pipe 0 */
+    u8_t reserved     : 2;  
   } bits;
   u8_t byte;
 } NRF24L01RegRxPwP0_t;
@@ -203,8 +260,8 @@ typedef union
 {
   struct
   {
-    u8_t RX_PW_P1     : 1;  /* Num bytes in data pipe 1 */
-    u8_t reserved     : 7;  
+    u8_t RX_PW_P1     : 6;  /* Num bytes in data pipe 1 */
+    u8_t reserved     : 2;  
   } bits;
   u8_t byte;
 } NRF24L01RegRxPwP1_t;
@@ -213,8 +270,8 @@ typedef union
 {
   struct
   {
-    u8_t RX_PW_P2     : 1;  /* Num bytes in data pipe 2 */
-    u8_t reserved     : 7;  
+    u8_t RX_PW_P2     : 6;  /* Num bytes in data pipe 2 */
+    u8_t reserved     : 2;  
   } bits;
   u8_t byte;
 } NRF24L01RegRxPwP2_t;
@@ -223,8 +280,8 @@ typedef union
 {
   struct
   {
-    u8_t RX_PW_P3     : 1;  /* Num bytes in data pipe 3 */
-    u8_t reserved     : 7;  
+    u8_t RX_PW_P3     : 6;  /* Num bytes in data pipe 3 */
+    u8_t reserved     : 2;  
   } bits;
   u8_t byte;
 } NRF24L01RegRxPwP3_t;
@@ -233,8 +290,8 @@ typedef union
 {
   struct
   {
-    u8_t RX_PW_P4     : 1;  /* Num bytes in data pipe 4 */
-    u8_t reserved     : 7;  
+    u8_t RX_PW_P4     : 6;  /* Num bytes in data pipe 4 */
+    u8_t reserved     : 2;  
   } bits;
   u8_t byte;
 } NRF24L01RegRxPwP4_t;
@@ -243,8 +300,8 @@ typedef union
 {
   struct
   {
-    u8_t RX_PW_P5     : 1;  /* Num bytes in data pipe 5 */
-    u8_t reserved     : 7;  
+    u8_t RX_PW_P5     : 6;  /* Num bytes in data pipe 5 */
+    u8_t reserved     : 2;  
   } bits;
   u8_t byte;
 } NRF24L01RegRxPwP5_t;
@@ -297,18 +354,75 @@ typedef union
   u8_t byte;
 } NRF24L01RegFeature_t;
 
-u8_t NRF24L01Init(void);
-u8_t NRF24L01SendPacket(u8_t *pPacket, u8_t numBytes);
+typedef void (*NRF24L01Callback_t)(void);
+
+typedef enum
+{
+  NRF24L01_TX_SENT        = 0x00,  /* TX_DS */
+  NRF24L01_TX_FAILED,              /* MAX_RT, no ACK after all retransmits */
+  NRF24L01_TX_TIMEOUT              /* neither within the timeout */
+} NRF24L01TxResult_t;
+
+typedef void (*NRF24L01TxCallback_t)(NRF24L01TxResult_t result);
+
+typedef void (*NRF24L01RxHandler_t)(u8_t pipe, const u8_t *pPacket, u8_t numBytes);
+
+/* one register write of a configuration profile */
+typedef struct
+{
+  u8_t addr;            /* NRF24L01RegAddr_t, NRF24L01_PROFILE_END ends the table */
+  u8_t value;
+} NRF24L01Setting_t;
+
+#define NRF24L01_PROFILE_END         (0xFF)
+
+extern const NRF24L01Setting_t NRF24L01ProfileLowPowerChild[];
+extern const NRF24L01Setting_t NRF24L01ProfileListeningParent[];
+extern const NRF24L01Setting_t NRF24L01ProfileLongRange[];
+extern const NRF24L01Setting_t NRF24L01ProfileLongRangeParent[];
+
+typedef struct
+{
+  u8_t  lastRetransmits;/* ARC_CNT of the last packet */
+  u8_t  lost;           /* PLOS_CNT, saturates at 15, reset by RF_CH */
+} NRF24L01TxStats_t;
+
+u8_t NRF24L01Init(const NRF24L01Setting_t *pProfile);
+u8_t NRF24L01SendPacketAsync(const u8_t *pPacket, u8_t numBytes, NRF24L01TxCallback_t pDone);
+bool NRF24L01Tick(void);
+const NRF24L01TxStats_t *NRF24L01GetTxStats(void);
+u8_t NRF24L01PowerDown(void);
+u8_t NRF24L01PowerUp(void);
+bool NRF24L01IsPoweredUp(void);
+void NRF24L01WaitPowerUp(void);
 u8_t NRF24L01StartTransmitMode(void);
-bool NRF24L01IsPacketTransmitted(void);
-u8_t NRF24L01WriteFifo(u8_t *pPacket, u8_t numBytes);
+u8_t NRF24L01WriteFifo(const u8_t *pPacket, u8_t numBytes);
 u8_t NRF24L01InitiateTransmit(void);
-u8_t NRF24L01EndTransmitMode(void);
-u8_t NRF24L01ReceivePacket(u8_t *pPacket, u8_t maxBytes);
 u8_t NRF24L01StartReceiveMode(void);
-u8_t NRF24L01EndReceiveMode(void);
-bool NRF24L01IsPacketReceived(void);
 u8_t NRF24L01ReadFifo(u8_t *pPacket, u8_t maxBytes);
+u8_t NRF24L01DrainRxFifo(u8_t *pBuffer, u8_t maxBytes, NRF24L01RxHandler_t pHandler);
+u8_t NRF24L01VerifyRegisters(void);
+u8_t NRF24L01EnableDynamicPayload(u8_t pipeMask);
+u8_t NRF24L01ReadPayloadWidth(void);
+u8_t NRF24L01WriteAckPayload(u8_t pipe, const u8_t *pPayload, u8_t numBytes);
+u8_t NRF24L01FlushAckPayloads(void);
+u8_t NRF24L01ReadAckPayload(u8_t *pPayload, u8_t maxBytes);
+u8_t NRF24L01ReadRegisters(NRF24L01RegAddr_t addr, u8_t *pBuf, u8_t numBytes);
+u8_t NRF24L01WriteRegisters(NRF24L01RegAddr_t addr, const u8_t *pBuf, u8_t numBytes);
+u8_t NRF24L01GetAddressWidth(void);
+u8_t NRF24L01SetTxAddress(const u8_t *pAddr);
+u8_t NRF24L01SetRxAddress(u8_t pipe, const u8_t *pAddr);
+u8_t NRF24L01EnableRxPipe(u8_t pipe, const u8_t *pAddr, u8_t width);
+u8_t NRF24L01DisableRxPipe(u8_t pipe);
+u8_t NRF24L01SetChannel(u8_t channel);
+u8_t NRF24L01SetTxPower(u8_t level);
+u8_t NRF24L01GetTxPower(void);
+u8_t NRF24L01SetDataRate(u8_t rate);
+u8_t NRF24L01GetDataRate(void);
+u8_t NRF24L01ReadCarrier(u8_t samples);
+u8_t NRF24L01SurveyChannel(u8_t channel, u8_t samples);
+u8_t NRF24L01ReadFifoStatus(void);
+u8_t NRF24L01EnableRxInterrupt(NRF24L01Callback_t pCallback);
 
 #endif
 
@@ -0,0 +1,85 @@
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+/* 
+  Downlink, Parent to Child. Queued by the Parent with
+  NRF24L01WriteAckPayload() and carried back on the ACK to the Child's
+  next packet: [command, argument]
+*/
+#define PROTOCOL_CMD_LOCATE       (0x01)  /* beep so the child can be found */
+#define PROTOCOL_CMD_SET_RATE     (0x02)  /* report period, in 500ms ticks */
+#define PROTOCOL_CMD_SILENCE      (0x03)  /* local fever beep: 0=on, 1=off */
+#define PROTOCOL_CMD_SYNC         (0x04)  /* slot error, PROTOCOL_SYNC_TICKS units */
+#define PROTOCOL_CMD_HOP          (0x05)  /* index into PROTOCOL_HOP_SEQUENCE */
+#define PROTOCOL_CMD_AIR_RATE     (0x06)  /* NRF24L01_DATA_RATE_xxx */
+
+#define PROTOCOL_CMD_SIZE         (2)
+
+/*
+  Uplink, Child to Parent: [battery, sequence, temperature...], battery
+  and temperatures 16 bits little endian. Both are ADC10 codes against
+  VREF+ = 1.5V, battery from Vcc/2, which saturates at Vcc = 3.0V. The
+  sequence counts every report sent, so that the Parent can count those
+  lost. The temperatures are the readings batched since the last
+  report, oldest first, the payload width gives their number.
+  A child sends its batch when full, at once on a change of
+  temperature, otherwise every PROTOCOL_HEARTBEAT_TICKS. Both ends
+  must be built with the same PROTOCOL_BATCH_READINGS, 1 reports only
+  changes and heartbeats and the Parent notices a lost child sooner.
+*/
+#define PROTOCOL_REPORT_HEADER    (3)
+#define PROTOCOL_MAX_READINGS     (14)    /* fills the 32-byte payload */
+
+#ifndef PROTOCOL_BATCH_READINGS
+#define PROTOCOL_BATCH_READINGS   (10)    /* 1..PROTOCOL_MAX_READINGS */
+#endif
+
+#if PROTOCOL_BATCH_READINGS > 1
+#define PROTOCOL_HEARTBEAT_TICKS  (2 * PROTOCOL_BATCH_READINGS)  /* a full batch of 1sec readings */
+#else
+#define PROTOCOL_HEARTBEAT_TICKS  (10)    /* 500ms timer periods = 5sec */
+#endif
+
+/*
+  Addressing. Child n transmits to {PROTOCOL_ADDR_LSB + n, PROTOCOL_ADDR_MSB,
+  ...} and is received on Parent pipe n. Pipes 1..5 share all but the
+  LSByte, so every address byte above the LSByte is PROTOCOL_ADDR_MSB.
+  Six pipes make six children per Parent, a child with a higher number
+  has nowhere to send and stays off the air.
+*/
+#define PROTOCOL_MAX_CHILDREN     (6)
+#define PROTOCOL_ADDR_LSB         (0xC1)
+#define PROTOCOL_ADDR_MSB         (0xC2)
+
+/*
+  Slots. The Parent's 500ms timer period is the superframe, each child
+  owns one slot of it and wakes every report period so that its packet
+  arrives mid-slot. The Parent cannot transmit a beacon without
+  disturbing the ACK payloads queued in its TX FIFO, so the beacon is
+  per child: the Parent stamps each packet against its superframe and
+  returns PROTOCOL_CMD_SYNC with how late it was, two's complement,
+  which also lets the child trim its timer to the Parent's clock.
+*/
+#define PROTOCOL_SUPERFRAME_TICKS (62500) /* 8us TimerA ticks = 500ms */
+#define PROTOCOL_SYNC_TICKS       (256)   /* ~2ms, +/-127 covers the superframe */
+
+/*
+  Channels. Both ends start on the first hop channel. The Parent moves
+  to the next usable one when carrier detect finds its channel busy,
+  telling each child with PROTOCOL_CMD_HOP first. The air rate is
+  changed the same way with PROTOCOL_CMD_AIR_RATE, both ends start at
+  the rate of their radio profiles. The Parent follows once every child
+  has taken the change, at most PROTOCOL_LINK_TICKS later, and a child
+  that took it holds on for that long however many reports fail. A
+  child that keeps failing after that has missed a change and searches
+  both rates on each hop channel in turn until it is heard.
+  Hops are at least 22MHz apart, a whole Wi-Fi channel, and stay in
+  the 2400-2483MHz band.
+*/
+#define PROTOCOL_LINK_TICKS       (2 * PROTOCOL_HEARTBEAT_TICKS)  /* superframes, two heartbeats */
+#define PROTOCOL_HOP_CHANNELS     (16)
+#define PROTOCOL_HOP_SEQUENCE     { 74, 15, 51,  2, 47, 71,  4, 60, \
+                                    82, 44,  9, 45,  7, 37, 69,  5 }
+
+#endif
+
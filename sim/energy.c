@@ -0,0 +1,121 @@
+/*! \file energy.c
+    \brief Battery-life model over the firmware's energy accounting
+
+ The firmware counts TimerA ticks per state in energyTicks[] (energy.h,
+ built with ENERGY_ACCOUNTING). Each state is charged at its datasheet
+ current for a 3V supply and the total is projected to mAh per day and
+ days on the battery. Ticks are folded every timer period, so up to
+ 500ms of a running state is missing at the end of the run.
+*/
+
+#include <stdio.h>
+
+#include "sim.h"
+
+/* energy.h */
+#define ENERGY_CPU              (0)
+#define ENERGY_ADC_REF          (1)
+#define ENERGY_BEEP             (2)
+#define ENERGY_RADIO_ON         (3)
+#define ENERGY_RADIO_TX         (4)
+#define ENERGY_RADIO_RX         (5)
+#define ENERGY_STATES           (6)
+
+#define ENERGY_CYCLES_PER_TICK  (8)       /* SMCLK/8 */
+#define ENERGY_RF_SETUP_DR      (0x08)
+
+/* MSP430F20x2 at 1MHz, nRF24L01, mA */
+#define ENERGY_MA_ACTIVE        (0.300)
+#define ENERGY_MA_LPM0          (0.075)
+#define ENERGY_MA_REF           (0.250)   /* I_REF+, conversions are too short to count */
+#define ENERGY_MA_BEEP          (1.500)   /* piezo, assumed, depends on the part */
+#define ENERGY_MA_POWER_DOWN    (0.0009)
+#define ENERGY_MA_STANDBY       (0.022)   /* Standby-I */
+#define ENERGY_MA_RX_2M         (12.3)
+#define ENERGY_MA_RX_1M         (11.8)
+
+/* TX current at RF_PWR -18, -12, -6, 0dBm */
+static const double energyMaTx[] = { 7.0, 7.5, 9.0, 11.3 };
+
+static double SimEnergyTxMa(double dbm);
+
+/*!
+ \brief Per node share of time in each state and the projected battery life
+ */
+void SimEnergyReport(void)
+{
+  const SimRadioStats_t *pStats;
+  const SimNode_t *pNode;
+  double ticks[ENERGY_STATES];
+  double nsPerTick;
+  double seconds;
+  double active;
+  double lpm;
+  double standby;
+  double off;
+  double mas;
+  double mah;
+  double rxMa;
+  uint8_t i;
+  uint8_t s;
+
+  printf("\nenergy, child%s%s.so, %.0f mAh battery\n", simConfig.pChildImage ? "-" : "",
+         simConfig.pChildImage ? simConfig.pChildImage : "", simConfig.batteryMah);
+  printf(" node   active  ADC ref   beep  radio on      TX      RX   avg mA  mAh/day   days\n");
+  for (i = 0; i < simNumNodes; i++)
+  {
+    pNode = simNodes[i];
+    if (pNode->isParent)
+      printf("%5s", "P");
+    else
+      printf("%5u", pNode->childId);
+    if (pNode->state == SIM_NODE_DEAD)
+    {
+      printf("  stopped\n");
+      continue;
+    }
+
+    nsPerTick = ENERGY_CYCLES_PER_TICK * pNode->nsPerCycle;
+    seconds = (double)(simConfig.endNs - pNode->bootNs) / SIM_NS_PER_S;
+    for (s = 0; s < ENERGY_STATES; s++)
+      ticks[s] = (double)pNode->pEnergyTicks[s] * nsPerTick / SIM_NS_PER_S;
+
+    pStats = SimRadioGetStats(pNode->pRadio);
+    rxMa = (SimRadioGetRfSetup(pNode->pRadio) & ENERGY_RF_SETUP_DR) ? ENERGY_MA_RX_2M : ENERGY_MA_RX_1M;
+    active = ticks[ENERGY_CPU];
+    lpm = (seconds > active) ? seconds - active : 0.0;
+    standby = ticks[ENERGY_RADIO_ON] - ticks[ENERGY_RADIO_TX] - ticks[ENERGY_RADIO_RX];
+    if (standby < 0.0)
+      standby = 0.0;
+    off = (seconds > ticks[ENERGY_RADIO_ON]) ? seconds - ticks[ENERGY_RADIO_ON] : 0.0;
+
+    mas = active * ENERGY_MA_ACTIVE + lpm * ENERGY_MA_LPM0 +
+          ticks[ENERGY_ADC_REF] * ENERGY_MA_REF + ticks[ENERGY_BEEP] * ENERGY_MA_BEEP +
+          off * ENERGY_MA_POWER_DOWN + standby * ENERGY_MA_STANDBY +
+          ticks[ENERGY_RADIO_TX] * SimEnergyTxMa(pStats->sent ? pStats->dbmSum / pStats->sent : 0.0) +
+          ticks[ENERGY_RADIO_RX] * rxMa;
+    mah = (seconds > 0.0) ? mas / seconds * 24.0 : 0.0;
+
+    printf("  %6.2f%%  %6.2f%%  %5.2f%%   %6.2f%%  %5.3f%%  %5.2f%%  %7.3f  %7.2f  %5.0f\n",
+           100.0 * active / seconds, 100.0 * ticks[ENERGY_ADC_REF] / seconds,
+           100.0 * ticks[ENERGY_BEEP] / seconds, 100.0 * ticks[ENERGY_RADIO_ON] / seconds,
+           100.0 * ticks[ENERGY_RADIO_TX] / seconds, 100.0 * ticks[ENERGY_RADIO_RX] / seconds,
+           mah / 24.0, mah, (mah > 0.0) ? simConfig.batteryMah / mah : 0.0);
+  }
+}
+
+/*!
+ \brief TX current at an average output power, interpolated
+ */
+static double SimEnergyTxMa(double dbm)
+{
+  double level = (dbm + 18.0) / 6.0;
+  int lower;
+
+  if (level <= 0.0)
+    return energyMaTx[0];
+  if (level >= 3.0)
+    return energyMaTx[3];
+  lower = (int)level;
+  return energyMaTx[lower] + (level - lower) * (energyMaTx[lower + 1] - energyMaTx[lower]);
+}
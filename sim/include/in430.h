@@ -0,0 +1,32 @@
+/*! \file in430.h
+    \brief Host stand-in for the IAR MSP430 intrinsics
+
+ The intrinsics act on the simulated status register of the running
+ node; low power modes hand the host CPU to the other nodes until an
+ enabled interrupt is pending.
+*/
+
+#ifndef _IN430_H_
+#define _IN430_H_
+
+#define __interrupt
+#define __even_in_range(value, bound)   (value)
+
+typedef unsigned short __istate_t;
+
+void __no_operation(void);
+void __enable_interrupt(void);
+void __disable_interrupt(void);
+__istate_t __get_interrupt_state(void);
+void __set_interrupt_state(__istate_t state);
+unsigned short __get_SR_register(void);
+void __bis_SR_register(unsigned short bits);
+void __bic_SR_register(unsigned short bits);
+void __bis_SR_register_on_exit(unsigned short bits);
+void __bic_SR_register_on_exit(unsigned short bits);
+void __low_power_mode_0(void);
+void __low_power_mode_3(void);
+void __low_power_mode_off_on_exit(void);
+void __delay_cycles(unsigned long cycles);
+
+#endif
@@ -0,0 +1,331 @@
+/*! \file io430x20x2.h
+    \brief Host stand-in for the IAR MSP430F20x2 register header
+
+ Every register expands to a call into the simulator, which brings the
+ node's peripherals up to date and returns the register's storage for
+ the running node. Bit names and vector numbers match the IAR header.
+*/
+
+#ifndef _IO430X20X2_H_
+#define _IO430X20X2_H_
+
+typedef enum
+{
+  SIM_P1IN,
+  SIM_P1OUT,
+  SIM_P1DIR,
+  SIM_P1IFG,
+  SIM_P1IES,
+  SIM_P1IE,
+  SIM_P1SEL,
+  SIM_P1REN,
+  SIM_P2IN,
+  SIM_P2OUT,
+  SIM_P2DIR,
+  SIM_P2IFG,
+  SIM_P2IES,
+  SIM_P2IE,
+  SIM_P2SEL,
+  SIM_P2REN,
+  SIM_USICTL0,
+  SIM_USICTL1,
+  SIM_USICKCTL,
+  SIM_USICNT,
+  SIM_USISRL,
+  SIM_USISRH,
+  SIM_ADC10DTC0,
+  SIM_ADC10DTC1,
+  SIM_ADC10AE0,
+  SIM_DCOCTL,
+  SIM_BCSCTL1,
+  SIM_BCSCTL2,
+  SIM_BCSCTL3,
+  SIM_CALDCO_1MHZ,
+  SIM_CALBC1_1MHZ,
+  SIM_IE1,
+  SIM_IFG1,
+  SIM_WDTCTL,
+  SIM_TACTL,
+  SIM_TAR,
+  SIM_TACCR0,
+  SIM_TACCR1,
+  SIM_TACCTL0,
+  SIM_TACCTL1,
+  SIM_TAIV,
+  SIM_ADC10CTL0,
+  SIM_ADC10CTL1,
+  SIM_ADC10MEM,
+  SIM_ADC10SA,
+
+  SIM_REG_MAX
+} SimReg_t;
+
+void *SimRegister(SimReg_t reg);
+unsigned char SimNodeId(void);
+
+#define SIM_REG8(name)    (*(volatile unsigned char *)SimRegister(SIM_##name))
+#define SIM_REG16(name)   (*(volatile unsigned short *)SimRegister(SIM_##name))
+#define SIM_BITS8(name)   (*(volatile struct { unsigned char name##_0 : 1, name##_1 : 1, \
+                                                              name##_2 : 1, name##_3 : 1, \
+                                                              name##_4 : 1, name##_5 : 1, \
+                                                              name##_6 : 1, name##_7 : 1; } *) \
+                           SimRegister(SIM_##name))
+#define SIM_CCTL(name)    (*(volatile struct { unsigned short CCIFG : 1, COV : 1, OUT : 1, CCI : 1, \
+                                                               CCIE : 1, OUTMOD : 3, CAP : 1, : 1, \
+                                                               SCCI : 1, SCS : 1, CCIS : 2, CM : 2; } *) \
+                           SimRegister(SIM_##name))
+
+#define P1IN                   SIM_REG8(P1IN)
+#define P1IN_bit               SIM_BITS8(P1IN)
+#define P1OUT                  SIM_REG8(P1OUT)
+#define P1OUT_bit              SIM_BITS8(P1OUT)
+#define P1DIR                  SIM_REG8(P1DIR)
+#define P1DIR_bit              SIM_BITS8(P1DIR)
+#define P1IFG                  SIM_REG8(P1IFG)
+#define P1IFG_bit              SIM_BITS8(P1IFG)
+#define P1IES                  SIM_REG8(P1IES)
+#define P1IES_bit              SIM_BITS8(P1IES)
+#define P1IE                   SIM_REG8(P1IE)
+#define P1IE_bit               SIM_BITS8(P1IE)
+#define P1SEL                  SIM_REG8(P1SEL)
+#define P1SEL_bit              SIM_BITS8(P1SEL)
+#define P1REN                  SIM_REG8(P1REN)
+#define P1REN_bit              SIM_BITS8(P1REN)
+#define P2IN                   SIM_REG8(P2IN)
+#define P2IN_bit               SIM_BITS8(P2IN)
+#define P2OUT                  SIM_REG8(P2OUT)
+#define P2OUT_bit              SIM_BITS8(P2OUT)
+#define P2DIR                  SIM_REG8(P2DIR)
+#define P2DIR_bit              SIM_BITS8(P2DIR)
+#define P2IFG                  SIM_REG8(P2IFG)
+#define P2IFG_bit              SIM_BITS8(P2IFG)
+#define P2IES                  SIM_REG8(P2IES)
+#define P2IES_bit              SIM_BITS8(P2IES)
+#define P2IE                   SIM_REG8(P2IE)
+#define P2IE_bit               SIM_BITS8(P2IE)
+#define P2SEL                  SIM_REG8(P2SEL)
+#define P2SEL_bit              SIM_BITS8(P2SEL)
+#define P2REN                  SIM_REG8(P2REN)
+#define P2REN_bit              SIM_BITS8(P2REN)
+#define USICTL0                SIM_REG8(USICTL0)
+#define USICTL0_bit            SIM_BITS8(USICTL0)
+#define USICTL1                SIM_REG8(USICTL1)
+#define USICTL1_bit            SIM_BITS8(USICTL1)
+#define USICKCTL               SIM_REG8(USICKCTL)
+#define USICKCTL_bit           SIM_BITS8(USICKCTL)
+#define USICNT                 SIM_REG8(USICNT)
+#define USICNT_bit             SIM_BITS8(USICNT)
+#define USISRL                 SIM_REG8(USISRL)
+#define USISRL_bit             SIM_BITS8(USISRL)
+#define USISRH                 SIM_REG8(USISRH)
+#define USISRH_bit             SIM_BITS8(USISRH)
+#define ADC10DTC0              SIM_REG8(ADC10DTC0)
+#define ADC10DTC0_bit          SIM_BITS8(ADC10DTC0)
+#define ADC10DTC1              SIM_REG8(ADC10DTC1)
+#define ADC10DTC1_bit          SIM_BITS8(ADC10DTC1)
+#define ADC10AE0               SIM_REG8(ADC10AE0)
+#define ADC10AE0_bit           SIM_BITS8(ADC10AE0)
+#define DCOCTL                 SIM_REG8(DCOCTL)
+#define DCOCTL_bit             SIM_BITS8(DCOCTL)
+#define BCSCTL1                SIM_REG8(BCSCTL1)
+#define BCSCTL1_bit            SIM_BITS8(BCSCTL1)
+#define BCSCTL2                SIM_REG8(BCSCTL2)
+#define BCSCTL2_bit            SIM_BITS8(BCSCTL2)
+#define BCSCTL3                SIM_REG8(BCSCTL3)
+#define BCSCTL3_bit            SIM_BITS8(BCSCTL3)
+#define CALDCO_1MHZ            SIM_REG8(CALDCO_1MHZ)
+#define CALDCO_1MHZ_bit        SIM_BITS8(CALDCO_1MHZ)
+#define CALBC1_1MHZ            SIM_REG8(CALBC1_1MHZ)
+#define CALBC1_1MHZ_bit        SIM_BITS8(CALBC1_1MHZ)
+#define IE1                    SIM_REG8(IE1)
+#define IE1_bit                SIM_BITS8(IE1)
+#define IFG1                   SIM_REG8(IFG1)
+#define IFG1_bit               SIM_BITS8(IFG1)
+#define WDTCTL                 SIM_REG16(WDTCTL)
+#define TACTL                  SIM_REG16(TACTL)
+#define TAR                    SIM_REG16(TAR)
+#define TACCR0                 SIM_REG16(TACCR0)
+#define TACCR1                 SIM_REG16(TACCR1)
+#define TACCTL0                SIM_REG16(TACCTL0)
+#define TACCTL1                SIM_REG16(TACCTL1)
+#define TAIV                   SIM_REG16(TAIV)
+#define ADC10CTL0              SIM_REG16(ADC10CTL0)
+#define ADC10CTL1              SIM_REG16(ADC10CTL1)
+#define ADC10MEM               SIM_REG16(ADC10MEM)
+#define ADC10SA                SIM_REG16(ADC10SA)
+#define TACCTL0_bit            SIM_CCTL(TACCTL0)
+#define TACCTL1_bit            SIM_CCTL(TACCTL1)
+
+#define BIT0                   (0x0001)
+#define BIT1                   (0x0002)
+#define BIT2                   (0x0004)
+#define BIT3                   (0x0008)
+#define BIT4                   (0x0010)
+#define BIT5                   (0x0020)
+#define BIT6                   (0x0040)
+#define BIT7                   (0x0080)
+#define BIT8                   (0x0100)
+#define BIT9                   (0x0200)
+#define BITA                   (0x0400)
+#define BITB                   (0x0800)
+#define BITC                   (0x1000)
+#define BITD                   (0x2000)
+#define BITE                   (0x4000)
+#define BITF                   (0x8000)
+
+/* status register */
+#define GIE                    (0x0008)
+#define CPUOFF                 (0x0010)
+#define OSCOFF                 (0x0020)
+#define SCG0                   (0x0040)
+#define SCG1                   (0x0080)
+#define LPM0_bits              (CPUOFF)
+#define LPM1_bits              (SCG0 + CPUOFF)
+#define LPM2_bits              (SCG1 + CPUOFF)
+#define LPM3_bits              (SCG1 + SCG0 + CPUOFF)
+#define LPM4_bits              (SCG1 + SCG0 + OSCOFF + CPUOFF)
+
+/* special function registers */
+#define WDTIE                  (0x01)
+#define OFIE                   (0x02)
+#define NMIIE                  (0x10)
+#define WDTIFG                 (0x01)
+#define OFIFG                  (0x02)
+#define PORIFG                 (0x04)
+#define RSTIFG                 (0x08)
+#define NMIIFG                 (0x10)
+
+/* basic clock */
+#define XT2OFF                 (0x80)
+#define DIVA_0                 (0x00)
+#define DIVA_1                 (0x10)
+#define DIVA_2                 (0x20)
+#define DIVA_3                 (0x30)
+#define SELM_0                 (0x00)
+#define DIVM_0                 (0x00)
+#define SELS                   (0x08)
+#define DIVS_0                 (0x00)
+#define DIVS_1                 (0x02)
+#define DIVS_2                 (0x04)
+#define DIVS_3                 (0x06)
+#define LFXT1S_0               (0x00)
+#define LFXT1S_2               (0x20)
+
+/* watchdog */
+#define WDTPW                  (0x5A00)
+#define WDTHOLD                (0x0080)
+#define WDTNMIES               (0x0040)
+#define WDTNMI                 (0x0020)
+#define WDTTMSEL               (0x0010)
+#define WDTCNTCL               (0x0008)
+#define WDTSSEL                (0x0004)
+#define WDTIS1                 (0x0002)
+#define WDTIS0                 (0x0001)
+
+/* Timer_A */
+#define TASSEL_0               (0x0000)
+#define TASSEL_1               (0x0100)
+#define TASSEL_2               (0x0200)
+#define TASSEL_3               (0x0300)
+#define ID_0                   (0x0000)
+#define ID_1                   (0x0040)
+#define ID_2                   (0x0080)
+#define ID_3                   (0x00C0)
+#define MC_0                   (0x0000)
+#define MC_1                   (0x0010)
+#define MC_2                   (0x0020)
+#define MC_3                   (0x0030)
+#define TACLR                  (0x0004)
+#define TAIE                   (0x0002)
+#define TAIFG                  (0x0001)
+#define CM_0                   (0x0000)
+#define CCIS_0                 (0x0000)
+#define OUTMOD_0               (0x0000)
+/* CCIE, CCIFG and the other single bits are TACCTLx_bit fields, as in IAR C */
+
+/* USI */
+#define USIPE7                 (0x80)
+#define USIPE6                 (0x40)
+#define USIPE5                 (0x20)
+#define USILSB                 (0x10)
+#define USIMST                 (0x08)
+#define USIGE                  (0x04)
+#define USIOE                  (0x02)
+#define USISWRST               (0x01)
+#define USICKPH                (0x80)
+#define USII2C                 (0x40)
+#define USISTTIE               (0x20)
+#define USIIE                  (0x10)
+#define USIAL                  (0x08)
+#define USISTP                 (0x04)
+#define USISTTIFG              (0x02)
+#define USIIFG                 (0x01)
+#define USIDIV_0               (0x00)
+#define USIDIV_1               (0x20)
+#define USIDIV_2               (0x40)
+#define USIDIV_3               (0x60)
+#define USISSEL_0              (0x00)
+#define USISSEL_2              (0x08)
+#define USICKPL                (0x02)
+#define USISWCLK               (0x01)
+#define USISCLREL              (0x80)
+#define USI16B                 (0x40)
+#define USIIFGCC               (0x20)
+
+/* ADC10 */
+#define SREF_0                 (0x0000)
+#define SREF_1                 (0x2000)
+#define ADC10SHT_0             (0x0000)
+#define ADC10SHT_1             (0x0800)
+#define ADC10SHT_2             (0x1000)
+#define ADC10SHT_3             (0x1800)
+#define ADC10SR                (0x0400)
+#define REFOUT                 (0x0200)
+#define REFBURST               (0x0100)
+#define MSC                    (0x0080)
+#define REF2_5V                (0x0040)
+#define REFON                  (0x0020)
+#define ADC10ON                (0x0010)
+#define ADC10IE                (0x0008)
+#define ADC10IFG               (0x0004)
+#define ENC                    (0x0002)
+#define ADC10SC                (0x0001)
+#define INCH_0                 (0x0000)
+#define INCH_10                (0xA000)
+#define INCH_11                (0xB000)
+#define INCH_15                (0xF000)
+#define SHS_0                  (0x0000)
+#define ADC10DF                (0x0200)
+#define ISSH                   (0x0100)
+#define ADC10DIV_0             (0x0000)
+#define ADC10DIV_1             (0x0020)
+#define ADC10DIV_2             (0x0040)
+#define ADC10DIV_3             (0x0060)
+#define ADC10DIV_4             (0x0080)
+#define ADC10DIV_5             (0x00A0)
+#define ADC10DIV_6             (0x00C0)
+#define ADC10DIV_7             (0x00E0)
+#define ADC10SSEL_0            (0x0000)
+#define ADC10SSEL_3            (0x0018)
+#define CONSEQ_0               (0x0000)
+#define CONSEQ_1               (0x0002)
+#define CONSEQ_2               (0x0004)
+#define CONSEQ_3               (0x0006)
+#define ADC10BUSY              (0x0001)
+#define ADC10TB                (0x08)
+#define ADC10CT                (0x04)
+#define ADC10B1                (0x02)
+#define ADC10FETCH             (0x01)
+
+/* interrupt vectors, byte offsets as in the IAR header */
+#define PORT1_VECTOR           (2 * 2u)
+#define PORT2_VECTOR           (3 * 2u)
+#define USI_VECTOR             (4 * 2u)
+#define ADC10_VECTOR           (5 * 2u)
+#define TIMERA1_VECTOR         (8 * 2u)
+#define TIMERA0_VECTOR         (9 * 2u)
+#define WDT_VECTOR             (10 * 2u)
+#define NMI_VECTOR             (14 * 2u)
+#define RESET_VECTOR           (15 * 2u)
+
+#endif
@@ -0,0 +1,678 @@
+/*! \file mcu.c
+    \brief MSP430F20x2 model, registers, peripherals, interrupts, intrinsics
+
+ Firmware reaches the model only through the register macros and the
+ intrinsics. Each access costs a few cycles, then the running node's
+ peripherals are brought up to its cycle count (Timer_A compares, USI
+ shifts, ADC10 conversions, P1.1 edges from the radio IRQ pin) and any
+ enabled interrupt is taken before the access completes. Low power modes
+ park the coroutine until the next peripheral event or an IRQ edge.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "in430.h"
+#include "sim.h"
+
+#define SIM_STACK_SIZE          (256 * 1024)
+#define SIM_ACCESS_CYCLES       (2)       /* mov to or from a peripheral */
+#define SIM_INTERRUPT_CYCLES    (11)      /* accept 6, reti 5 */
+#define SIM_DELAY_STEP          (256)     /* cycles between syncs in __delay_cycles */
+
+#define TACCTL_CCIE             (0x0010)
+#define TACCTL_CCIFG            (0x0001)
+
+#define SIM_PIN_CSN             (BIT2)    /* P1.2 */
+#define SIM_PIN_CE              (BIT3)    /* P1.3 */
+#define SIM_PIN_IRQ             (BIT1)    /* P1.1 */
+#define SIM_PIN_PIEZO           (BIT6)    /* P2.6 */
+#define SIM_BEEP_SILENCE        (20 * SIM_NS_PER_MS)
+
+#define SIM_ADC10OSC_HZ         (5000000.0)
+#define SIM_VREF_LOW            (1.5)
+#define SIM_VREF_HIGH           (2.5)
+#define SIM_ADC_NOISE_LSB       (1.0)     /* rms */
+
+static ucontext_t schedulerContext;
+
+static void SimEntry(void);
+static void SimYield(SimNode_t *pNode);
+static void SimAdvance(SimNode_t *pNode, uint64_t cycles);
+static void SimService(SimNode_t *pNode);
+static void SimSync(SimNode_t *pNode);
+static void SimSyncAdc(SimNode_t *pNode);
+static void SimSyncTimer(SimNode_t *pNode);
+static bool SimDispatch(SimNode_t *pNode);
+static void SimLowPower(SimNode_t *pNode);
+static uint64_t SimNextEvent(const SimNode_t *pNode, bool enabledOnly);
+static uint16_t SimAdcSample(const SimNode_t *pNode, uint16_t channel);
+static void *SimDataAddress(const SimNode_t *pNode, uint16_t address);
+static void SimPiezoToggle(SimNode_t *pNode, int64_t ns);
+
+/*!
+ \brief Power-on reset values, the radio IRQ pin idles high
+ */
+void SimNodeInit(SimNode_t *pNode)
+{
+  memset(pNode->reg, 0, sizeof(pNode->reg));
+  pNode->reg[SIM_WDTCTL] = 0x6900;
+  pNode->reg[SIM_USICTL0] = USISWRST;
+  pNode->reg[SIM_USICTL1] = USIIFG;
+  pNode->reg[SIM_DCOCTL] = 0x60;
+  pNode->reg[SIM_BCSCTL1] = 0x87;
+  pNode->reg[SIM_CALDCO_1MHZ] = 0x8A;
+  pNode->reg[SIM_CALBC1_1MHZ] = 0x86;
+  pNode->reg[SIM_P1IN] = SIM_PIN_IRQ;
+  memcpy(pNode->seen, pNode->reg, sizeof(pNode->seen));
+
+  pNode->sr = 0;
+  pNode->srDepth = 0;
+  pNode->cycles = 0;
+  pNode->timerBase = 0;
+  pNode->timerTicks = 0;
+  pNode->usiBusy = false;
+  pNode->adcBusy = false;
+  pNode->adcRunning = false;
+  pNode->irqLine = true;
+  pNode->irqSeen = true;
+  pNode->numBeeps = 0;
+  pNode->lastToggleNs = 0;
+}
+
+/*!
+ \brief Prepare the coroutine, firmware main() runs on the first resume
+ */
+void SimNodeStart(SimNode_t *pNode)
+{
+  pNode->pStack = malloc(SIM_STACK_SIZE);
+  if (pNode->pStack == NULL)
+  {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  getcontext(&pNode->context);
+  pNode->context.uc_stack.ss_sp = pNode->pStack;
+  pNode->context.uc_stack.ss_size = SIM_STACK_SIZE;
+  pNode->context.uc_link = &schedulerContext;
+  makecontext(&pNode->context, SimEntry, 0);
+  pNode->state = SIM_NODE_SLEEPING;
+  pNode->wakeNs = pNode->bootNs;
+}
+
+/*!
+ \brief Run the node until its clock passes limitNs or it sleeps
+
+ A sleeping node's DCO kept running, its cycle count catches up to now.
+ */
+void SimNodeResume(SimNode_t *pNode, int64_t limitNs)
+{
+  uint64_t cycles;
+
+  if (pNode->state == SIM_NODE_SLEEPING)
+  {
+    cycles = (uint64_t)ceil((double)(simNow - pNode->bootNs) / pNode->nsPerCycle);
+    if (cycles > pNode->cycles)
+      pNode->cycles = cycles;
+    pNode->state = SIM_NODE_RUNNING;
+  }
+  pNode->limitNs = limitNs;
+  pSimCurrent = pNode;
+  swapcontext(&schedulerContext, &pNode->context);
+  pSimCurrent = NULL;
+}
+
+/*!
+ \brief Node clock in simulation time
+ */
+int64_t SimNodeNs(const SimNode_t *pNode)
+{
+  return pNode->bootNs + (int64_t)((double)pNode->cycles * pNode->nsPerCycle);
+}
+
+/*!
+ \brief Radio IRQ pin level changed, wake the node to look at P1.1
+ */
+void SimNodeIrq(SimNode_t *pNode, bool level)
+{
+  pNode->irqLine = level;
+  if ((pNode->state == SIM_NODE_SLEEPING) && (pNode->wakeNs > simNow))
+    pNode->wakeNs = simNow;
+}
+
+/*!
+ \brief Firmware entry, main() never returns but a crash path might
+ */
+static void SimEntry(void)
+{
+  pSimCurrent->pMain();
+  fprintf(stderr, "node %u: main() returned\n", pSimCurrent->index);
+  pSimCurrent->state = SIM_NODE_DEAD;
+}
+
+/*!
+ \brief Back to the scheduler, the node is resumed where it stopped
+ */
+static void SimYield(SimNode_t *pNode)
+{
+  swapcontext(&pNode->context, &schedulerContext);
+}
+
+/*!
+ \brief Spend CPU cycles, other nodes get the host once the quantum is up
+ */
+static void SimAdvance(SimNode_t *pNode, uint64_t cycles)
+{
+  pNode->cycles += cycles;
+  if (SimNodeNs(pNode) > pNode->limitNs)
+    SimYield(pNode);
+}
+
+/*!
+ \brief Sync peripherals and take every pending enabled interrupt
+ */
+static void SimService(SimNode_t *pNode)
+{
+  SimSync(pNode);
+  while ((pNode->sr & GIE) && SimDispatch(pNode))
+    SimSync(pNode);
+}
+
+/*!
+ \brief Bring the peripherals up to the node's cycle count
+
+ Writes since the last sync are found by comparing with seen[]. Only
+ the pins and peripherals the firmware uses are modelled.
+ */
+static void SimSync(SimNode_t *pNode)
+{
+  uint16_t *pReg = pNode->reg;
+  uint16_t *pSeen = pNode->seen;
+  int64_t ns = SimNodeNs(pNode);
+  uint16_t changed;
+  uint8_t miso;
+
+  /* radio control pins, CSN first so a byte started with it selects */
+  changed = pReg[SIM_P1OUT] ^ pSeen[SIM_P1OUT];
+  if (changed & SIM_PIN_CSN)
+    SimRadioSetCsn(pNode->pRadio, (pReg[SIM_P1OUT] & SIM_PIN_CSN) != 0, ns);
+  if (changed & SIM_PIN_CE)
+    SimRadioSetCe(pNode->pRadio, (pReg[SIM_P1OUT] & SIM_PIN_CE) != 0, ns);
+
+  changed = pReg[SIM_P2OUT] ^ pSeen[SIM_P2OUT];
+  if (changed & SIM_PIN_PIEZO)
+    SimPiezoToggle(pNode, ns);
+
+  /* USI, a non-zero count starts a transfer which clears USIIFG */
+  if ((pReg[SIM_USICNT] & 0x1F) && !pNode->usiBusy && !(pReg[SIM_USICTL0] & USISWRST))
+  {
+    pNode->usiBusy = true;
+    pNode->usiDone = pNode->cycles + (uint64_t)(pReg[SIM_USICNT] & 0x1F) *
+                     (1U << ((pReg[SIM_USICKCTL] >> 5) & 0x07));
+    pReg[SIM_USICTL1] &= ~USIIFG;
+  }
+  if (pNode->usiBusy && (pNode->cycles >= pNode->usiDone))
+  {
+    miso = 0xFF;
+    if (!(pReg[SIM_P1OUT] & SIM_PIN_CSN))
+      miso = SimRadioSpi(pNode->pRadio, (uint8_t)pReg[SIM_USISRL], ns);
+    pReg[SIM_USISRL] = miso;
+    pReg[SIM_USICNT] &= ~0x1F;
+    pReg[SIM_USICTL1] |= USIIFG;
+    pNode->usiBusy = false;
+  }
+
+  SimSyncAdc(pNode);
+  SimSyncTimer(pNode);
+
+  /* P1.1 follows the radio IRQ pin, P1IES selects the flagged edge */
+  if (pNode->irqLine != pNode->irqSeen)
+  {
+    if (pNode->irqLine != ((pReg[SIM_P1IES] & SIM_PIN_IRQ) != 0))
+      pReg[SIM_P1IFG] |= SIM_PIN_IRQ;
+    pNode->irqSeen = pNode->irqLine;
+  }
+  if (pNode->irqLine)
+    pReg[SIM_P1IN] |= SIM_PIN_IRQ;
+  else
+    pReg[SIM_P1IN] &= ~SIM_PIN_IRQ;
+
+  memcpy(pSeen, pReg, sizeof(pNode->seen));
+}
+
+/*!
+ \brief ADC10, the four CONSEQ modes and the DTC in one-block mode
+
+ A conversion is the sample-and-hold time plus 13 ADC10OSC clocks. With
+ MSC the next one of a sequence follows at once, else it waits for
+ ADC10SC. Clearing ENC stops at the end of the conversion, clearing it
+ with CONSEQ_0 or clearing ADC10ON at once. The DTC starts over with
+ each sequence.
+ */
+static void SimSyncAdc(SimNode_t *pNode)
+{
+  static const uint8_t holdClocks[4] = { 4, 8, 16, 64 };
+  uint16_t *pReg = pNode->reg;
+  uint16_t conseq = pReg[SIM_ADC10CTL1] & CONSEQ_3;
+  uint16_t sample;
+  bool start = false;
+  double adcNs;
+
+  if (!(pReg[SIM_ADC10CTL0] & ADC10ON))
+  {
+    pNode->adcBusy = false;
+    pNode->adcRunning = false;
+    pReg[SIM_ADC10CTL1] &= ~ADC10BUSY;
+    return;
+  }
+
+  if (pNode->adcBusy && (pNode->cycles >= pNode->adcDone))
+  {
+    sample = SimAdcSample(pNode, pNode->adcChannel);
+    pReg[SIM_ADC10MEM] = sample;
+    pNode->adcBusy = false;
+    if (pReg[SIM_ADC10DTC1] == 0)
+      pReg[SIM_ADC10CTL0] |= ADC10IFG;
+    else if (pNode->adcDtcIndex < pReg[SIM_ADC10DTC1])
+    {
+      *(uint16_t *)SimDataAddress(pNode, pReg[SIM_ADC10SA] + 2 * pNode->adcDtcIndex) = sample;
+      if (++pNode->adcDtcIndex == pReg[SIM_ADC10DTC1])
+        pReg[SIM_ADC10CTL0] |= ADC10IFG;
+    }
+
+    if (!(pReg[SIM_ADC10CTL0] & ENC) || (conseq == CONSEQ_0) ||
+        ((conseq == CONSEQ_1) && (pNode->adcChannel == 0)))
+      pNode->adcRunning = false;
+    else if (conseq != CONSEQ_2)
+      pNode->adcChannel = pNode->adcChannel ? pNode->adcChannel - 1 : pReg[SIM_ADC10CTL1] >> 12;
+    start = pNode->adcRunning && (pReg[SIM_ADC10CTL0] & MSC);
+  }
+  if (!(pReg[SIM_ADC10CTL0] & ENC) && (conseq == CONSEQ_0))
+  {
+    pNode->adcBusy = false;
+    pNode->adcRunning = false;
+    start = false;
+  }
+
+  if (!pNode->adcBusy && !start &&
+      ((pReg[SIM_ADC10CTL0] & (ENC + ADC10SC)) == (ENC + ADC10SC)))
+  {
+    pReg[SIM_ADC10CTL0] &= ~ADC10SC;
+    if (!pNode->adcRunning)
+    {
+      pNode->adcRunning = true;
+      pNode->adcChannel = pReg[SIM_ADC10CTL1] >> 12;
+      pNode->adcDtcIndex = 0;
+    }
+    start = true;
+  }
+
+  if (start)
+  {
+    adcNs = (holdClocks[(pReg[SIM_ADC10CTL0] >> 11) & 0x03] + 13.0) *
+            (((pReg[SIM_ADC10CTL1] >> 5) & 0x07) + 1) * 1e9 / SIM_ADC10OSC_HZ;
+    pNode->adcBusy = true;
+    pNode->adcDone = pNode->cycles + (uint64_t)ceil(adcNs / pNode->nsPerCycle);
+  }
+  if (pNode->adcRunning)
+    pReg[SIM_ADC10CTL1] |= ADC10BUSY;
+  else
+    pReg[SIM_ADC10CTL1] &= ~ADC10BUSY;
+}
+
+/*!
+ \brief Timer_A from SMCLK, continuous mode, compares on TAR == TACCRx
+
+ Each compare value passed since the last sync sets its TACCTL_CCIFG, so a
+ TACCR0 written behind TAR waits for the counter to wrap, as on the part.
+ */
+static void SimSyncTimer(SimNode_t *pNode)
+{
+  uint16_t *pReg = pNode->reg;
+  uint64_t ticks;
+  uint64_t last = pNode->timerTicks;
+  uint16_t ccr[2];
+  uint8_t i;
+
+  if ((pReg[SIM_TACTL] & MC_3) == MC_0)
+    return;
+
+  ticks = pNode->cycles >> ((pReg[SIM_TACTL] >> 6) & 0x03);
+  if (pReg[SIM_TACTL] & TACLR)
+  {
+    pReg[SIM_TACTL] &= ~TACLR;
+    pNode->timerBase = ticks;
+    last = 0;
+  }
+  ticks -= pNode->timerBase;
+
+  ccr[0] = pReg[SIM_TACCR0];
+  ccr[1] = pReg[SIM_TACCR1];
+  if (ticks > last)
+  {
+    for (i = 0; i < 2; i++)
+    {
+      if (last + 1 + (uint16_t)(ccr[i] - (uint16_t)(last + 1)) <= ticks)
+        pReg[i ? SIM_TACCTL1 : SIM_TACCTL0] |= TACCTL_CCIFG;
+    }
+    if ((last >> 16) != (ticks >> 16))
+      pReg[SIM_TACTL] |= TAIFG;
+  }
+  pNode->timerTicks = ticks;
+  pReg[SIM_TAR] = (uint16_t)ticks;
+}
+
+/*!
+ \brief Take the highest priority pending interrupt, if any
+
+ The SR is stacked and cleared, as by the CPU, so the ISR may change the
+ copy it returns to with __low_power_mode_off_on_exit().
+ */
+static bool SimDispatch(SimNode_t *pNode)
+{
+  uint16_t *pReg = pNode->reg;
+  unsigned short vector;
+  const SimVector_t *pVector;
+
+  if ((pReg[SIM_TACCTL0] & (TACCTL_CCIE + TACCTL_CCIFG)) == (TACCTL_CCIE + TACCTL_CCIFG))
+  {
+    vector = TIMERA0_VECTOR;
+    pReg[SIM_TACCTL0] &= ~TACCTL_CCIFG;
+  }
+  else if (((pReg[SIM_TACCTL1] & (TACCTL_CCIE + TACCTL_CCIFG)) == (TACCTL_CCIE + TACCTL_CCIFG)) ||
+           ((pReg[SIM_TACTL] & (TAIE + TAIFG)) == (TAIE + TAIFG)))
+    vector = TIMERA1_VECTOR;
+  else if ((pReg[SIM_ADC10CTL0] & (ADC10IE + ADC10IFG)) == (ADC10IE + ADC10IFG))
+  {
+    vector = ADC10_VECTOR;
+    pReg[SIM_ADC10CTL0] &= ~ADC10IFG;
+  }
+  else if ((pReg[SIM_USICTL1] & (USIIE + USIIFG)) == (USIIE + USIIFG))
+    vector = USI_VECTOR;
+  else if (pReg[SIM_P2IE] & pReg[SIM_P2IFG])
+    vector = PORT2_VECTOR;
+  else if (pReg[SIM_P1IE] & pReg[SIM_P1IFG])
+    vector = PORT1_VECTOR;
+  else
+    return false;
+
+  for (pVector = pNode->pVectors; pVector->pHandler != NULL; pVector++)
+  {
+    if (pVector->vector == vector)
+      break;
+  }
+  if (pVector->pHandler == NULL)
+  {
+    fprintf(stderr, "node %u: no handler for vector %u\n", pNode->index, vector);
+    exit(EXIT_FAILURE);
+  }
+
+  if (pNode->srDepth >= sizeof(pNode->srStack) / sizeof(pNode->srStack[0]))
+  {
+    fprintf(stderr, "node %u: interrupt nesting overflow\n", pNode->index);
+    exit(EXIT_FAILURE);
+  }
+  pNode->srStack[pNode->srDepth++] = pNode->sr;
+  pNode->sr &= SCG0;
+  SimAdvance(pNode, SIM_INTERRUPT_CYCLES);
+  pVector->pHandler();
+  pNode->sr = pNode->srStack[--pNode->srDepth];
+  return true;
+}
+
+/*!
+ \brief Sleep while CPUOFF is set, an ISR clears it on exit to wake main
+ */
+static void SimLowPower(SimNode_t *pNode)
+{
+  uint64_t next;
+
+  SimService(pNode);
+  while (pNode->sr & CPUOFF)
+  {
+    next = SimNextEvent(pNode, true);
+    pNode->wakeNs = SIM_NEVER;
+    if (next != UINT64_MAX)
+      pNode->wakeNs = pNode->bootNs + (int64_t)ceil((double)next * pNode->nsPerCycle);
+    pNode->state = SIM_NODE_SLEEPING;
+    SimYield(pNode);
+    SimService(pNode);
+  }
+}
+
+/*!
+ \brief Cycle count of the next peripheral event, UINT64_MAX when none
+
+ enabledOnly skips events that cannot raise an interrupt, for sleeping.
+ */
+static uint64_t SimNextEvent(const SimNode_t *pNode, bool enabledOnly)
+{
+  const uint16_t *pReg = pNode->reg;
+  uint64_t next = UINT64_MAX;
+  uint64_t ticks = pNode->timerTicks;
+  uint64_t at;
+  uint8_t shift = (pReg[SIM_TACTL] >> 6) & 0x03;
+
+  if (pNode->usiBusy && (!enabledOnly || (pReg[SIM_USICTL1] & USIIE)) && (pNode->usiDone < next))
+    next = pNode->usiDone;
+  if (pNode->adcBusy && (!enabledOnly || (pReg[SIM_ADC10CTL0] & ADC10IE)) && (pNode->adcDone < next))
+    next = pNode->adcDone;
+
+  if ((pReg[SIM_TACTL] & MC_3) != MC_0)
+  {
+    if (!enabledOnly || (pReg[SIM_TACCTL0] & TACCTL_CCIE))
+    {
+      at = (pNode->timerBase + ticks + 1 + (uint16_t)(pReg[SIM_TACCR0] - (uint16_t)(ticks + 1))) << shift;
+      if (at < next)
+        next = at;
+    }
+    if (!enabledOnly || (pReg[SIM_TACCTL1] & TACCTL_CCIE))
+    {
+      at = (pNode->timerBase + ticks + 1 + (uint16_t)(pReg[SIM_TACCR1] - (uint16_t)(ticks + 1))) << shift;
+      if (at < next)
+        next = at;
+    }
+    if (!enabledOnly || (pReg[SIM_TACTL] & TAIE))
+    {
+      at = (pNode->timerBase + (ticks | 0xFFFF) + 1) << shift;
+      if (at < next)
+        next = at;
+    }
+  }
+  return next;
+}
+
+/*!
+ \brief ADC10MEM for a conversion, the sensor and Vcc/2 against VREF+
+ */
+static uint16_t SimAdcSample(const SimNode_t *pNode, uint16_t channel)
+{
+  double vref = (pNode->reg[SIM_ADC10CTL0] & REF2_5V) ? SIM_VREF_HIGH : SIM_VREF_LOW;
+  double volts;
+  double code;
+  double noise = 0.0;
+  uint8_t i;
+
+  if (!(pNode->reg[SIM_ADC10CTL0] & SREF_1))
+    vref = pNode->vcc;
+
+  if (channel == 10)
+    volts = 0.00355 * pNode->temperature + 0.986;
+  else if (channel == 11)
+    volts = pNode->vcc / 2.0;
+  else
+    volts = 0.0;
+
+  /* Irwin-Hall, twelve uniforms less six is close to a unit normal */
+  for (i = 0; i < 12; i++)
+    noise += SimRandom();
+  code = floor(volts / vref * 1023.0 + 0.5 + (noise - 6.0) * SIM_ADC_NOISE_LSB);
+  if (code < 0.0)
+    code = 0.0;
+  if (code > 1023.0)
+    code = 1023.0;
+  return (uint16_t)code;
+}
+
+/*!
+ \brief Host address of a 16-bit firmware data address, for the DTC
+
+ The firmware's variables sit in its image's data segment, well within
+ 32KB of probes[], which supplies the upper bits.
+ */
+static void *SimDataAddress(const SimNode_t *pNode, uint16_t address)
+{
+  uintptr_t ref = (uintptr_t)pNode->pProbes;
+  uintptr_t host = (ref & ~(uintptr_t)0xFFFF) | address;
+
+  if (host > ref + 0x8000)
+    host -= 0x10000;
+  else if (host + 0x8000 < ref)
+    host += 0x10000;
+  return (void *)host;
+}
+
+/*!
+ \brief Piezo pin toggled, bursts separated by silence are beeps
+ */
+static void SimPiezoToggle(SimNode_t *pNode, int64_t ns)
+{
+  if (((pNode->numBeeps == 0) || (ns - pNode->lastToggleNs > SIM_BEEP_SILENCE)) &&
+      (pNode->numBeeps < SIM_MAX_BEEPS))
+    pNode->beeps[pNode->numBeeps++].start = ns;
+  if (pNode->numBeeps > 0)
+    pNode->beeps[pNode->numBeeps - 1].end = ns;
+  pNode->lastToggleNs = ns;
+}
+
+void *SimRegister(SimReg_t reg)
+{
+  SimNode_t *pNode = pSimCurrent;
+  uint16_t *pReg = pNode->reg;
+
+  SimAdvance(pNode, SIM_ACCESS_CYCLES);
+  SimService(pNode);
+
+  /* reading TAIV acknowledges the source it reports */
+  if (reg == SIM_TAIV)
+  {
+    pReg[SIM_TAIV] = 0;
+    if ((pReg[SIM_TACCTL1] & (TACCTL_CCIE + TACCTL_CCIFG)) == (TACCTL_CCIE + TACCTL_CCIFG))
+    {
+      pReg[SIM_TAIV] = 2;
+      pReg[SIM_TACCTL1] &= ~TACCTL_CCIFG;
+    }
+    else if ((pReg[SIM_TACTL] & (TAIE + TAIFG)) == (TAIE + TAIFG))
+    {
+      pReg[SIM_TAIV] = 10;
+      pReg[SIM_TACTL] &= ~TAIFG;
+    }
+    pNode->seen[SIM_TAIV] = pReg[SIM_TAIV];
+  }
+  return &pReg[reg];
+}
+
+unsigned char SimNodeId(void)
+{
+  return pSimCurrent->childId;
+}
+
+void __no_operation(void)
+{
+  SimAdvance(pSimCurrent, 1);
+  SimService(pSimCurrent);
+}
+
+void __enable_interrupt(void)
+{
+  pSimCurrent->sr |= GIE;
+  SimAdvance(pSimCurrent, 1);
+  SimService(pSimCurrent);
+}
+
+void __disable_interrupt(void)
+{
+  pSimCurrent->sr &= ~GIE;
+  SimAdvance(pSimCurrent, 1);
+}
+
+__istate_t __get_interrupt_state(void)
+{
+  return pSimCurrent->sr & GIE;
+}
+
+void __set_interrupt_state(__istate_t state)
+{
+  pSimCurrent->sr = (pSimCurrent->sr & ~GIE) | (state & GIE);
+  SimAdvance(pSimCurrent, 1);
+  SimService(pSimCurrent);
+}
+
+unsigned short __get_SR_register(void)
+{
+  return pSimCurrent->sr;
+}
+
+void __bis_SR_register(unsigned short bits)
+{
+  pSimCurrent->sr |= bits;
+  SimAdvance(pSimCurrent, 1);
+  SimLowPower(pSimCurrent);
+}
+
+void __bic_SR_register(unsigned short bits)
+{
+  pSimCurrent->sr &= ~bits;
+  SimAdvance(pSimCurrent, 1);
+  SimService(pSimCurrent);
+}
+
+void __bis_SR_register_on_exit(unsigned short bits)
+{
+  if (pSimCurrent->srDepth > 0)
+    pSimCurrent->srStack[pSimCurrent->srDepth - 1] |= bits;
+}
+
+void __bic_SR_register_on_exit(unsigned short bits)
+{
+  if (pSimCurrent->srDepth > 0)
+    pSimCurrent->srStack[pSimCurrent->srDepth - 1] &= ~bits;
+}
+
+void __low_power_mode_0(void)
+{
+  __bis_SR_register(LPM0_bits + GIE);
+}
+
+void __low_power_mode_3(void)
+{
+  __bis_SR_register(LPM3_bits + GIE);
+}
+
+void __low_power_mode_off_on_exit(void)
+{
+  __bic_SR_register_on_exit(LPM4_bits);
+}
+
+/*!
+ \brief Busy wait, in steps so interrupts land close to their time
+ */
+void __delay_cycles(unsigned long cycles)
+{
+  SimNode_t *pNode = pSimCurrent;
+  uint64_t step;
+  uint64_t next;
+
+  while (cycles > 0)
+  {
+    step = (cycles < SIM_DELAY_STEP) ? cycles : SIM_DELAY_STEP;
+    next = SimNextEvent(pNode, false);
+    if ((next > pNode->cycles) && (next - pNode->cycles < step))
+      step = next - pNode->cycles;
+    SimAdvance(pNode, step);
+    SimService(pNode);
+    cycles -= step;
+  }
+}
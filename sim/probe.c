@@ -0,0 +1,68 @@
+/*! \file probe.c
+    \brief Report of the firmware's execution time probes
+
+ The firmware keeps count, min, max and total TimerA ticks per probe in
+ probes[] (probe.h, built with PROBE_TIMING). They are shown in cycles,
+ the Parent on its own and the children merged.
+*/
+
+#include <stdio.h>
+
+#include "sim.h"
+
+#define PROBE_CYCLES_PER_TICK   (8)       /* SMCLK/8 */
+
+static const char *const probeNames[SIM_PROBE_MAX] =
+{
+  "TimerA0 ISR", "radio IRQ ISR", "send", "event handlers"
+};
+
+static void SimProbeRow(uint8_t probe, const char *pName, bool isParent);
+
+/*!
+ \brief Per probe count, min, average and max, in cycles
+ */
+void SimProbeReport(void)
+{
+  uint8_t p;
+
+  printf("\nprobes, cycles     node       count     min      avg     max\n");
+  for (p = 0; p < SIM_PROBE_MAX; p++)
+  {
+    SimProbeRow(p, probeNames[p], true);
+    SimProbeRow(p, "", false);
+  }
+}
+
+static void SimProbeRow(uint8_t probe, const char *pName, bool isParent)
+{
+  const char *pNode = isParent ? "Parent" : "children";
+  const SimProbe_t *pProbe;
+  uint64_t count = 0;
+  uint64_t total = 0;
+  unsigned min = 0xFFFF;
+  unsigned max = 0;
+  uint8_t i;
+
+  for (i = 0; i < simNumNodes; i++)
+  {
+    if (simNodes[i]->isParent != isParent)
+      continue;
+    pProbe = &simNodes[i]->pProbes[probe];
+    if (pProbe->count == 0)
+      continue;
+    count += pProbe->count;
+    total += pProbe->total;
+    if (pProbe->min < min)
+      min = pProbe->min;
+    if (pProbe->max > max)
+      max = pProbe->max;
+  }
+
+  if (count == 0)
+    printf("%-16s  %-8s  %8u\n", pName, pNode, 0);
+  else
+    printf("%-16s  %-8s  %8llu  %6u  %7.0f  %6u\n", pName, pNode, (unsigned long long)count,
+           min * PROBE_CYCLES_PER_TICK, (double)total * PROBE_CYCLES_PER_TICK / count,
+           max * PROBE_CYCLES_PER_TICK);
+}
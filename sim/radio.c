@@ -0,0 +1,939 @@
+/*! \file radio.c
+    \brief nRF24L01 model and the shared air between the nodes
+
+ The register file, FIFOs and SPI commands follow the datasheet as far
+ as the driver uses them. Enhanced ShockBurst runs as a state machine in
+ simulation time: 1.5ms power up, 130us TX/RX settling, auto retransmit
+ after ARD up to ARC times then MAX_RT, PID and CRC duplicate filtering
+ and ACK payloads per pipe.
+
+ Every packet is a transmission on the air list. A reception needs the
+ receiver listening on the same channel and rate since the preamble, no
+ other transmission overlapping on the channel, and survives the link
+ margin, the configured random loss and the WLAN interferer.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+/* registers */
+#define REG_CONFIG              (0x00)
+#define REG_EN_AA               (0x01)
+#define REG_EN_RXADDR           (0x02)
+#define REG_SETUP_AW            (0x03)
+#define REG_SETUP_RETR          (0x04)
+#define REG_RF_CH               (0x05)
+#define REG_RF_SETUP            (0x06)
+#define REG_STATUS              (0x07)
+#define REG_OBSERVE_TX          (0x08)
+#define REG_CD                  (0x09)
+#define REG_RX_ADDR_P0          (0x0A)
+#define REG_RX_ADDR_P1          (0x0B)
+#define REG_RX_ADDR_P2          (0x0C)
+#define REG_TX_ADDR             (0x10)
+#define REG_RX_PW_P0            (0x11)
+#define REG_FIFO_STATUS         (0x17)
+#define REG_DYNPD               (0x1C)
+#define REG_FEATURE             (0x1D)
+#define REG_COUNT               (0x1E)
+
+#define CONFIG_PRIM_RX          (0x01)
+#define CONFIG_PWR_UP           (0x02)
+#define CONFIG_CRCO             (0x04)
+#define CONFIG_EN_CRC           (0x08)
+#define STATUS_MAX_RT           (0x10)
+#define STATUS_TX_DS            (0x20)
+#define STATUS_RX_DR            (0x40)
+#define STATUS_IRQS             (0x70)
+#define RF_SETUP_DR             (0x08)
+#define FEATURE_EN_DYN_ACK      (0x01)
+#define FEATURE_EN_ACK_PAY      (0x02)
+#define FEATURE_EN_DPL          (0x04)
+
+/* commands */
+#define CMD_R_REGISTER          (0x00)
+#define CMD_W_REGISTER          (0x20)
+#define CMD_ACTIVATE            (0x50)
+#define CMD_R_RX_PL_WID         (0x60)
+#define CMD_R_RX_PAYLOAD        (0x61)
+#define CMD_W_TX_PAYLOAD        (0xA0)
+#define CMD_W_ACK_PAYLOAD       (0xA8)
+#define CMD_W_TX_PAYLOAD_NOACK  (0xB0)
+#define CMD_FLUSH_TX            (0xE1)
+#define CMD_FLUSH_RX            (0xE2)
+#define ACTIVATE_KEY            (0x73)
+
+#define FIFO_DEPTH              (3)
+#define MAX_PAYLOAD             (32)
+#define MAX_ADDR                (5)
+#define NUM_PIPES               (6)
+#define PIPE_NONE               (0xFF)
+
+#define T_POWER_UP              (1500 * SIM_NS_PER_US)  /* Tpd2stby */
+#define T_SETTLE                (130 * SIM_NS_PER_US)   /* Tstby2a, TX and RX */
+#define T_ARD_STEP              (250 * SIM_NS_PER_US)
+#define T_AIR_KEEP              (2 * SIM_NS_PER_MS)     /* > longest packet */
+
+#define SENSITIVITY_1MBPS       (-85.0)   /* dBm at 0.1% BER */
+#define SENSITIVITY_2MBPS       (-82.0)
+#define CARRIER_DBM             (-64.0)   /* CD threshold */
+#define WLAN_HALF_WIDTH         (11)      /* channels, 22MHz */
+
+typedef enum
+{
+  RADIO_POWER_DOWN,
+  RADIO_STARTING,
+  RADIO_STANDBY,
+  RADIO_RX_SETTLE,
+  RADIO_RX,
+  RADIO_TX_SETTLE,
+  RADIO_TX,
+  RADIO_ACK_WAIT,
+  RADIO_ACK_SETTLE,
+  RADIO_ACK_TX
+} RadioState_t;
+
+typedef struct
+{
+  uint8_t pipe;                     /* RX pipe, or ACK payload pipe */
+  uint8_t len;
+  bool noAck;
+  uint8_t data[MAX_PAYLOAD];
+} Payload_t;
+
+struct SimTransmission
+{
+  SimTransmission_t *pNext;
+  SimRadio_t *pSender;
+  int64_t start;
+  int64_t end;
+  uint8_t channel;
+  bool rate2M;
+  uint8_t aw;
+  uint8_t addr[MAX_ADDR];
+  uint8_t crc;
+  bool ack;
+  bool noAck;
+  uint8_t pid;
+  uint8_t ackPipe;                  /* ACK carrying a payload of this pipe */
+  uint8_t len;
+  uint8_t data[MAX_PAYLOAD];
+  double dbm;
+  bool collided;
+  bool aborted;
+};
+
+struct SimRadio
+{
+  SimNode_t *pNode;
+  double pathLossDb;
+  bool dead;
+
+  uint8_t reg[REG_COUNT];
+  uint8_t addrP0[MAX_ADDR];
+  uint8_t addrP1[MAX_ADDR];
+  uint8_t addrTx[MAX_ADDR];
+  bool activated;
+  bool ce;
+  bool irq;
+
+  /* SPI command, executed when CSN rises */
+  bool selected;
+  uint8_t cmd;
+  uint8_t count;
+  uint8_t buf[MAX_PAYLOAD];
+
+  Payload_t tx[FIFO_DEPTH];
+  uint8_t txCount;
+  Payload_t rx[FIFO_DEPTH];
+  uint8_t rxCount;
+
+  RadioState_t state;
+  uint32_t gen;                     /* stale timers carry an older one */
+  int64_t rxSinceNs;
+  SimTransmission_t *pAir;
+  uint8_t pid;
+  bool txNew;
+  uint8_t ackPipe;
+  uint8_t ackPid;
+  uint8_t ackAddr[MAX_ADDR];
+
+  /* duplicate filter, per pipe */
+  bool lastValid[NUM_PIPES];
+  uint8_t lastPid[NUM_PIPES];
+  uint32_t lastCrc[NUM_PIPES];
+
+  SimRadioStats_t stats;
+};
+
+static SimTransmission_t *pAirList = NULL;
+
+static void RadioEnter(SimRadio_t *pRadio, RadioState_t state, int64_t ns, int64_t timeoutNs);
+static void RadioUpdate(SimRadio_t *pRadio, int64_t ns);
+static void RadioTimer(void *pArg, uint32_t tag);
+static void RadioIrq(SimRadio_t *pRadio);
+static void RadioTransmit(SimRadio_t *pRadio, int64_t ns);
+static void RadioSendAck(SimRadio_t *pRadio, int64_t ns);
+static void RadioTxDone(SimRadio_t *pRadio, SimTransmission_t *pTx, int64_t ns);
+static void RadioTxSuccess(SimRadio_t *pRadio, int64_t ns);
+static void RadioReceive(SimRadio_t *pRadio, SimTransmission_t *pTx, int64_t ns);
+static void RadioCommit(SimRadio_t *pRadio, int64_t ns);
+static void RadioWriteRegister(SimRadio_t *pRadio, uint8_t addr, int64_t ns);
+static uint8_t RadioReadRegister(SimRadio_t *pRadio, uint8_t addr, uint8_t index, int64_t ns);
+static uint8_t RadioAddressWidth(const SimRadio_t *pRadio);
+static uint8_t RadioCrc(const SimRadio_t *pRadio);
+static double RadioDbm(const SimRadio_t *pRadio);
+static int RadioMatchPipe(const SimRadio_t *pRadio, const SimTransmission_t *pTx);
+static bool RadioCarrier(const SimRadio_t *pRadio, int64_t ns);
+static SimTransmission_t *AirStart(SimRadio_t *pSender, int64_t ns, const uint8_t *pAddr,
+                                   const Payload_t *pPayload, bool ack);
+static void AirEnd(void *pArg, uint32_t tag);
+static bool AirLinkOk(const SimTransmission_t *pTx, const SimRadio_t *pReceiver);
+static double AirPathLoss(const SimRadio_t *pA, const SimRadio_t *pB);
+static bool AirWlan(uint8_t channel);
+
+/*!
+ \brief Radio at its power-on reset values, path loss is to the Parent
+ */
+SimRadio_t *SimRadioCreate(SimNode_t *pNode, double pathLossDb)
+{
+  static const uint8_t resetValues[REG_COUNT] =
+  {
+    0x08, 0x3F, 0x03, 0x03, 0x03, 0x02, 0x0F, 0x0E,
+    0x00, 0x00, 0xE7, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6,
+    0xE7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+  };
+  SimRadio_t *pRadio = calloc(1, sizeof(SimRadio_t));
+
+  if (pRadio == NULL)
+  {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  pRadio->pNode = pNode;
+  pRadio->pathLossDb = pathLossDb;
+  memcpy(pRadio->reg, resetValues, sizeof(resetValues));
+  memset(pRadio->addrP0, 0xE7, MAX_ADDR);
+  memset(pRadio->addrP1, 0xC2, MAX_ADDR);
+  memset(pRadio->addrTx, 0xE7, MAX_ADDR);
+  pRadio->irq = true;
+  pRadio->state = RADIO_POWER_DOWN;
+  pRadio->txNew = true;
+  return pRadio;
+}
+
+/*!
+ \brief CSN low starts a command, high executes what was shifted in
+ */
+void SimRadioSetCsn(SimRadio_t *pRadio, bool level, int64_t ns)
+{
+  if (pRadio->dead)
+    return;
+  if (!level)
+  {
+    pRadio->selected = true;
+    pRadio->count = 0;
+    return;
+  }
+  if (pRadio->selected && (pRadio->count > 0))
+    RadioCommit(pRadio, ns);
+  pRadio->selected = false;
+}
+
+void SimRadioSetCe(SimRadio_t *pRadio, bool level, int64_t ns)
+{
+  if (pRadio->dead)
+    return;
+  pRadio->ce = level;
+  RadioUpdate(pRadio, ns);
+}
+
+/*!
+ \brief One SPI byte, the first of a command clocks out STATUS
+ */
+uint8_t SimRadioSpi(SimRadio_t *pRadio, uint8_t mosi, int64_t ns)
+{
+  uint8_t index;
+  uint8_t status;
+
+  if (pRadio->dead || !pRadio->selected)
+    return 0xFF;
+
+  if (pRadio->count == 0)
+  {
+    pRadio->cmd = mosi;
+    pRadio->count = 1;
+    status = pRadio->reg[REG_STATUS] & ~0x0F;
+    status |= (pRadio->rxCount ? pRadio->rx[0].pipe : 0x07) << 1;
+    if (pRadio->txCount == FIFO_DEPTH)
+      status |= 0x01;
+    return status;
+  }
+
+  index = pRadio->count - 1;
+  if (pRadio->count < 0xFF)
+    pRadio->count++;
+
+  if (pRadio->cmd < CMD_W_REGISTER)
+    return RadioReadRegister(pRadio, pRadio->cmd & 0x1F, index, ns);
+  if (pRadio->cmd == CMD_R_RX_PL_WID)
+    return pRadio->rxCount ? pRadio->rx[0].len : 0;
+  if (pRadio->cmd == CMD_R_RX_PAYLOAD)
+    return (pRadio->rxCount && (index < pRadio->rx[0].len)) ? pRadio->rx[0].data[index] : 0;
+  if (index < MAX_PAYLOAD)
+    pRadio->buf[index] = mosi;
+  return 0;
+}
+
+/*!
+ \brief Node killed, its radio leaves the air for good
+ */
+void SimRadioKill(SimRadio_t *pRadio, int64_t ns)
+{
+  (void)ns;
+  pRadio->dead = true;
+  pRadio->gen++;
+  pRadio->state = RADIO_POWER_DOWN;
+  if (pRadio->pAir != NULL)
+    pRadio->pAir->aborted = true;
+}
+
+/*!
+ \brief RF_SETUP as last written, data rate and output power
+ */
+uint8_t SimRadioGetRfSetup(const SimRadio_t *pRadio)
+{
+  return pRadio->reg[REG_RF_SETUP];
+}
+
+/*!
+ \brief 
+ */
+const SimRadioStats_t *SimRadioGetStats(const SimRadio_t *pRadio)
+{
+  return &pRadio->stats;
+}
+
+/*!
+ \brief Change state, a non-zero timeout fires RadioTimer() in that state
+ */
+static void RadioEnter(SimRadio_t *pRadio, RadioState_t state, int64_t ns, int64_t timeoutNs)
+{
+  pRadio->state = state;
+  pRadio->gen++;
+  if (state == RADIO_RX)
+    pRadio->rxSinceNs = ns;
+  if (timeoutNs > 0)
+    SimSchedule(ns + timeoutNs, RadioTimer, pRadio, pRadio->gen);
+}
+
+/*!
+ \brief Follow PWR_UP, PRIM_RX, CE and the TX FIFO from standby
+
+ TX sequences and ACKs run to completion whatever CE does.
+ */
+static void RadioUpdate(SimRadio_t *pRadio, int64_t ns)
+{
+  bool prx = (pRadio->reg[REG_CONFIG] & CONFIG_PRIM_RX) != 0;
+
+  if (!(pRadio->reg[REG_CONFIG] & CONFIG_PWR_UP))
+  {
+    if (pRadio->state != RADIO_POWER_DOWN)
+    {
+      if (pRadio->pAir != NULL)
+        pRadio->pAir->aborted = true;
+      pRadio->pAir = NULL;
+      RadioEnter(pRadio, RADIO_POWER_DOWN, ns, 0);
+    }
+    return;
+  }
+
+  switch (pRadio->state)
+  {
+  case RADIO_POWER_DOWN:
+    RadioEnter(pRadio, RADIO_STARTING, ns, T_POWER_UP);
+    break;
+  case RADIO_STANDBY:
+    if (prx && pRadio->ce)
+      RadioEnter(pRadio, RADIO_RX_SETTLE, ns, T_SETTLE);
+    else if (!prx && pRadio->ce && pRadio->txCount && !(pRadio->reg[REG_STATUS] & STATUS_MAX_RT))
+      RadioEnter(pRadio, RADIO_TX_SETTLE, ns, T_SETTLE);
+    break;
+  case RADIO_RX_SETTLE:
+  case RADIO_RX:
+    if (!prx || !pRadio->ce)
+    {
+      RadioEnter(pRadio, RADIO_STANDBY, ns, 0);
+      RadioUpdate(pRadio, ns);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static void RadioTimer(void *pArg, uint32_t tag)
+{
+  SimRadio_t *pRadio = pArg;
+  uint8_t arc;
+  uint8_t observe;
+
+  if ((tag != pRadio->gen) || pRadio->dead)
+    return;
+
+  switch (pRadio->state)
+  {
+  case RADIO_STARTING:
+    RadioEnter(pRadio, RADIO_STANDBY, simNow, 0);
+    RadioUpdate(pRadio, simNow);
+    break;
+  case RADIO_RX_SETTLE:
+    RadioEnter(pRadio, RADIO_RX, simNow, 0);
+    break;
+  case RADIO_TX_SETTLE:
+    if (pRadio->txCount)
+      RadioTransmit(pRadio, simNow);
+    else
+      RadioEnter(pRadio, RADIO_STANDBY, simNow, 0);
+    break;
+  case RADIO_ACK_SETTLE:
+    RadioSendAck(pRadio, simNow);
+    break;
+  case RADIO_ACK_WAIT:
+    /* no ACK within ARD, retransmit or give up with MAX_RT */
+    arc = pRadio->reg[REG_SETUP_RETR] & 0x0F;
+    observe = pRadio->reg[REG_OBSERVE_TX];
+    if ((observe & 0x0F) < arc)
+    {
+      pRadio->reg[REG_OBSERVE_TX] = observe + 1;
+      RadioTransmit(pRadio, simNow);
+      break;
+    }
+    if ((observe >> 4) < 0x0F)
+      observe += 0x10;
+    pRadio->reg[REG_OBSERVE_TX] = observe;
+    pRadio->reg[REG_STATUS] |= STATUS_MAX_RT;
+    pRadio->stats.failed++;
+    RadioEnter(pRadio, RADIO_STANDBY, simNow, 0);
+    RadioIrq(pRadio);
+    break;
+  default:
+    break;
+  }
+}
+
+/*!
+ \brief Drive the IRQ pin from the unmasked STATUS flags
+ */
+static void RadioIrq(SimRadio_t *pRadio)
+{
+  bool level = !(pRadio->reg[REG_STATUS] & STATUS_IRQS & ~pRadio->reg[REG_CONFIG]);
+
+  if (level != pRadio->irq)
+  {
+    pRadio->irq = level;
+    SimNodeIrq(pRadio->pNode, level);
+  }
+}
+
+/*!
+ \brief Send the TX FIFO head, a new packet takes the next PID
+ */
+static void RadioTransmit(SimRadio_t *pRadio, int64_t ns)
+{
+  if (pRadio->txNew)
+  {
+    pRadio->pid = (pRadio->pid + 1) & 0x03;
+    pRadio->reg[REG_OBSERVE_TX] &= 0xF0;
+    pRadio->txNew = false;
+    pRadio->stats.packets++;
+  }
+  pRadio->pAir = AirStart(pRadio, ns, pRadio->addrTx, &pRadio->tx[0], false);
+  RadioEnter(pRadio, RADIO_TX, ns, 0);
+}
+
+/*!
+ \brief PRX ACK, with the first ACK payload queued for the pipe
+ */
+static void RadioSendAck(SimRadio_t *pRadio, int64_t ns)
+{
+  static const Payload_t empty = { PIPE_NONE, 0, false, { 0 } };
+  const Payload_t *pPayload = &empty;
+  uint8_t i;
+
+  if (pRadio->reg[REG_FEATURE] & FEATURE_EN_ACK_PAY)
+  {
+    for (i = 0; i < pRadio->txCount; i++)
+    {
+      if (pRadio->tx[i].pipe == pRadio->ackPipe)
+      {
+        pPayload = &pRadio->tx[i];
+        break;
+      }
+    }
+  }
+  pRadio->pAir = AirStart(pRadio, ns, pRadio->ackAddr, pPayload, true);
+  pRadio->pAir->pid = pRadio->ackPid;
+  RadioEnter(pRadio, RADIO_ACK_TX, ns, 0);
+}
+
+/*!
+ \brief Own transmission over, wait for the ACK or finish
+ */
+static void RadioTxDone(SimRadio_t *pRadio, SimTransmission_t *pTx, int64_t ns)
+{
+  uint8_t i;
+
+  pRadio->pAir = NULL;
+  if (pTx->ack)
+  {
+    if (pTx->ackPipe != PIPE_NONE)
+    {
+      for (i = 0; i < pRadio->txCount; i++)
+      {
+        if (pRadio->tx[i].pipe == pTx->ackPipe)
+          break;
+      }
+      if (i < pRadio->txCount)
+      {
+        memmove(&pRadio->tx[i], &pRadio->tx[i + 1], (pRadio->txCount - i - 1) * sizeof(Payload_t));
+        pRadio->txCount--;
+        pRadio->reg[REG_STATUS] |= STATUS_TX_DS;
+        RadioIrq(pRadio);
+      }
+    }
+    RadioEnter(pRadio, RADIO_STANDBY, ns, 0);
+    RadioUpdate(pRadio, ns);
+    return;
+  }
+
+  if (pTx->noAck || !(pRadio->reg[REG_EN_AA] & 0x01))
+  {
+    RadioTxSuccess(pRadio, ns);
+    return;
+  }
+  RadioEnter(pRadio, RADIO_ACK_WAIT, ns, ((pRadio->reg[REG_SETUP_RETR] >> 4) + 1) * T_ARD_STEP);
+  pRadio->rxSinceNs = ns + T_SETTLE;
+}
+
+static void RadioTxSuccess(SimRadio_t *pRadio, int64_t ns)
+{
+  if (pRadio->txCount)
+  {
+    memmove(&pRadio->tx[0], &pRadio->tx[1], (pRadio->txCount - 1) * sizeof(Payload_t));
+    pRadio->txCount--;
+  }
+  pRadio->txNew = true;
+  pRadio->stats.acked++;
+  pRadio->reg[REG_STATUS] |= STATUS_TX_DS;
+  RadioEnter(pRadio, RADIO_STANDBY, ns, 0);
+  RadioIrq(pRadio);
+  RadioUpdate(pRadio, ns);
+}
+
+/*!
+ \brief A transmission ended, take it if this radio could hear it
+ */
+static void RadioReceive(SimRadio_t *pRadio, SimTransmission_t *pTx, int64_t ns)
+{
+  bool dpl;
+  bool dup;
+  uint32_t crc;
+  uint8_t i;
+  int pipe;
+  Payload_t *pPayload;
+
+  if (pRadio->dead || (pRadio == pTx->pSender))
+    return;
+  if (pTx->ack ? (pRadio->state != RADIO_ACK_WAIT) : (pRadio->state != RADIO_RX))
+    return;
+  if ((pRadio->rxSinceNs > pTx->start) || (pRadio->reg[REG_RF_CH] != pTx->channel) ||
+      (((pRadio->reg[REG_RF_SETUP] & RF_SETUP_DR) != 0) != pTx->rate2M) ||
+      (RadioCrc(pRadio) != pTx->crc))
+    return;
+  pipe = RadioMatchPipe(pRadio, pTx);
+  if ((pipe < 0) || pTx->collided || pTx->aborted || !AirLinkOk(pTx, pRadio))
+    return;
+  dpl = (pRadio->reg[REG_FEATURE] & FEATURE_EN_DPL) && (pRadio->reg[REG_DYNPD] & (1U << pipe));
+
+  if (pTx->ack)
+  {
+    if ((pipe != 0) || (pTx->pid != pRadio->pid))
+      return;
+    if (pTx->len && dpl && (pRadio->rxCount < FIFO_DEPTH))
+    {
+      pPayload = &pRadio->rx[pRadio->rxCount++];
+      pPayload->pipe = 0;
+      pPayload->len = pTx->len;
+      memcpy(pPayload->data, pTx->data, pTx->len);
+      pRadio->reg[REG_STATUS] |= STATUS_RX_DR;
+      pTx->pSender->stats.delivered++;
+    }
+    RadioTxSuccess(pRadio, ns);
+    return;
+  }
+
+  if (!dpl && (pTx->len != pRadio->reg[REG_RX_PW_P0 + pipe]))
+    return;
+
+  crc = 2166136261U;
+  for (i = 0; i < pTx->len; i++)
+    crc = (crc ^ pTx->data[i]) * 16777619U;
+  dup = pRadio->lastValid[pipe] && (pRadio->lastPid[pipe] == pTx->pid) && (pRadio->lastCrc[pipe] == crc);
+  if (!dup)
+  {
+    /* RX FIFO full, the packet is lost and not acknowledged */
+    if (pRadio->rxCount == FIFO_DEPTH)
+      return;
+    pPayload = &pRadio->rx[pRadio->rxCount++];
+    pPayload->pipe = (uint8_t)pipe;
+    pPayload->len = pTx->len;
+    memcpy(pPayload->data, pTx->data, pTx->len);
+    pRadio->lastValid[pipe] = true;
+    pRadio->lastPid[pipe] = pTx->pid;
+    pRadio->lastCrc[pipe] = crc;
+    pRadio->reg[REG_STATUS] |= STATUS_RX_DR;
+    pTx->pSender->stats.delivered++;
+    RadioIrq(pRadio);
+  }
+
+  if ((pRadio->reg[REG_EN_AA] & (1U << pipe)) && !pTx->noAck)
+  {
+    pRadio->ackPipe = (uint8_t)pipe;
+    pRadio->ackPid = pTx->pid;
+    memcpy(pRadio->ackAddr, pTx->addr, MAX_ADDR);
+    RadioEnter(pRadio, RADIO_ACK_SETTLE, ns, T_SETTLE);
+  }
+}
+
+/*!
+ \brief Execute the command shifted in since CSN fell
+ */
+static void RadioCommit(SimRadio_t *pRadio, int64_t ns)
+{
+  uint8_t cmd = pRadio->cmd;
+  uint8_t len = pRadio->count - 1;
+  Payload_t *pPayload;
+
+  if (len > MAX_PAYLOAD)
+    len = MAX_PAYLOAD;
+
+  if ((cmd >= CMD_W_REGISTER) && (cmd < CMD_W_REGISTER + 0x20))
+  {
+    if (len > 0)
+      RadioWriteRegister(pRadio, cmd & 0x1F, ns);
+  }
+  else if (cmd == CMD_R_RX_PAYLOAD)
+  {
+    if ((len > 0) && pRadio->rxCount)
+    {
+      memmove(&pRadio->rx[0], &pRadio->rx[1], (pRadio->rxCount - 1) * sizeof(Payload_t));
+      pRadio->rxCount--;
+    }
+  }
+  else if ((cmd == CMD_W_TX_PAYLOAD) || (cmd == CMD_W_TX_PAYLOAD_NOACK) ||
+           ((cmd & 0xF8) == CMD_W_ACK_PAYLOAD))
+  {
+    if ((cmd == CMD_W_TX_PAYLOAD_NOACK) && !(pRadio->reg[REG_FEATURE] & FEATURE_EN_DYN_ACK))
+      return;
+    if (((cmd & 0xF8) == CMD_W_ACK_PAYLOAD) && !(pRadio->reg[REG_FEATURE] & FEATURE_EN_ACK_PAY))
+      return;
+    if ((len == 0) || (pRadio->txCount == FIFO_DEPTH))
+      return;
+    pPayload = &pRadio->tx[pRadio->txCount++];
+    pPayload->pipe = ((cmd & 0xF8) == CMD_W_ACK_PAYLOAD) ? (cmd & 0x07) : PIPE_NONE;
+    pPayload->len = len;
+    pPayload->noAck = (cmd == CMD_W_TX_PAYLOAD_NOACK);
+    memcpy(pPayload->data, pRadio->buf, len);
+    pRadio->stats.queued++;
+    RadioUpdate(pRadio, ns);
+  }
+  else if (cmd == CMD_FLUSH_TX)
+  {
+    pRadio->txCount = 0;
+    pRadio->txNew = true;
+  }
+  else if (cmd == CMD_FLUSH_RX)
+    pRadio->rxCount = 0;
+  else if ((cmd == CMD_ACTIVATE) && (len > 0) && (pRadio->buf[0] == ACTIVATE_KEY))
+    pRadio->activated = !pRadio->activated;
+}
+
+static void RadioWriteRegister(SimRadio_t *pRadio, uint8_t addr, int64_t ns)
+{
+  uint8_t value = pRadio->buf[0];
+
+  switch (addr)
+  {
+  case REG_RX_ADDR_P0:
+    memcpy(pRadio->addrP0, pRadio->buf, MAX_ADDR);
+    pRadio->reg[addr] = value;
+    break;
+  case REG_RX_ADDR_P1:
+    memcpy(pRadio->addrP1, pRadio->buf, MAX_ADDR);
+    pRadio->reg[addr] = value;
+    break;
+  case REG_TX_ADDR:
+    memcpy(pRadio->addrTx, pRadio->buf, MAX_ADDR);
+    pRadio->reg[addr] = value;
+    break;
+  case REG_STATUS:
+    pRadio->reg[REG_STATUS] &= ~(value & STATUS_IRQS);
+    RadioIrq(pRadio);
+    RadioUpdate(pRadio, ns);
+    break;
+  case REG_OBSERVE_TX:
+  case REG_CD:
+  case REG_FIFO_STATUS:
+    break;
+  case REG_DYNPD:
+  case REG_FEATURE:
+    if (pRadio->activated)
+      pRadio->reg[addr] = value;
+    break;
+  case REG_RF_CH:
+    pRadio->reg[addr] = value & 0x7F;
+    pRadio->reg[REG_OBSERVE_TX] &= 0x0F;
+    break;
+  case REG_CONFIG:
+    pRadio->reg[addr] = value & 0x7F;
+    RadioIrq(pRadio);
+    RadioUpdate(pRadio, ns);
+    break;
+  default:
+    if (addr < REG_COUNT)
+      pRadio->reg[addr] = value;
+    break;
+  }
+}
+
+static uint8_t RadioReadRegister(SimRadio_t *pRadio, uint8_t addr, uint8_t index, int64_t ns)
+{
+  uint8_t value;
+
+  switch (addr)
+  {
+  case REG_RX_ADDR_P0:
+    return (index < MAX_ADDR) ? pRadio->addrP0[index] : 0;
+  case REG_RX_ADDR_P1:
+    return (index < MAX_ADDR) ? pRadio->addrP1[index] : 0;
+  case REG_TX_ADDR:
+    return (index < MAX_ADDR) ? pRadio->addrTx[index] : 0;
+  case REG_STATUS:
+    value = pRadio->reg[REG_STATUS] & ~0x0F;
+    value |= (pRadio->rxCount ? pRadio->rx[0].pipe : 0x07) << 1;
+    return value | ((pRadio->txCount == FIFO_DEPTH) ? 0x01 : 0x00);
+  case REG_CD:
+    return RadioCarrier(pRadio, ns) ? 0x01 : 0x00;
+  case REG_FIFO_STATUS:
+    value = 0;
+    if (pRadio->txCount == FIFO_DEPTH)
+      value |= 0x20;
+    if (pRadio->txCount == 0)
+      value |= 0x10;
+    if (pRadio->rxCount == FIFO_DEPTH)
+      value |= 0x02;
+    if (pRadio->rxCount == 0)
+      value |= 0x01;
+    return value;
+  case REG_DYNPD:
+  case REG_FEATURE:
+    return pRadio->activated ? pRadio->reg[addr] : 0;
+  default:
+    return (addr < REG_COUNT) ? pRadio->reg[addr] : 0;
+  }
+}
+
+static uint8_t RadioAddressWidth(const SimRadio_t *pRadio)
+{
+  uint8_t aw = pRadio->reg[REG_SETUP_AW] & 0x03;
+
+  return aw ? aw + 2 : 5;
+}
+
+static uint8_t RadioCrc(const SimRadio_t *pRadio)
+{
+  /* Enhanced ShockBurst forces CRC on while any pipe auto-acknowledges */
+  if (!(pRadio->reg[REG_CONFIG] & CONFIG_EN_CRC) && !(pRadio->reg[REG_EN_AA] & 0x3F))
+    return 0;
+  return (pRadio->reg[REG_CONFIG] & CONFIG_CRCO) ? 2 : 1;
+}
+
+static double RadioDbm(const SimRadio_t *pRadio)
+{
+  return -18.0 + 6.0 * ((pRadio->reg[REG_RF_SETUP] >> 1) & 0x03);
+}
+
+/*!
+ \brief Enabled pipe whose address the transmission carries, -1 if none
+
+ The ACK for a PTX always comes in on pipe 0.
+ */
+static int RadioMatchPipe(const SimRadio_t *pRadio, const SimTransmission_t *pTx)
+{
+  uint8_t aw = RadioAddressWidth(pRadio);
+  uint8_t pipe;
+
+  if (aw != pTx->aw)
+    return -1;
+  if (((pRadio->reg[REG_EN_RXADDR] & 0x01) || pTx->ack) && !memcmp(pTx->addr, pRadio->addrP0, aw))
+    return 0;
+  if (pTx->ack || memcmp(&pTx->addr[1], &pRadio->addrP1[1], aw - 1))
+    return -1;
+  for (pipe = 1; pipe < NUM_PIPES; pipe++)
+  {
+    if ((pRadio->reg[REG_EN_RXADDR] & (1U << pipe)) &&
+        (pTx->addr[0] == ((pipe == 1) ? pRadio->addrP1[0] : pRadio->reg[REG_RX_ADDR_P2 + pipe - 2])))
+      return pipe;
+  }
+  return -1;
+}
+
+/*!
+ \brief CD, energy above -64dBm on the channel while in RX
+ */
+static bool RadioCarrier(const SimRadio_t *pRadio, int64_t ns)
+{
+  const SimTransmission_t *pTx;
+
+  if (pRadio->state != RADIO_RX)
+    return false;
+  for (pTx = pAirList; pTx != NULL; pTx = pTx->pNext)
+  {
+    if ((pTx->pSender != pRadio) && (pTx->channel == pRadio->reg[REG_RF_CH]) &&
+        (pTx->start <= ns) && (pTx->end > ns) && !pTx->aborted &&
+        (pTx->dbm - AirPathLoss(pTx->pSender, pRadio) >= CARRIER_DBM))
+      return true;
+  }
+  return AirWlan(pRadio->reg[REG_RF_CH]);
+}
+
+/*!
+ \brief Put a packet on the air, its end is an event
+
+ Air time is preamble, address, 9 bit packet control field, payload and
+ CRC at the data rate.
+ */
+static SimTransmission_t *AirStart(SimRadio_t *pSender, int64_t ns, const uint8_t *pAddr,
+                                   const Payload_t *pPayload, bool ack)
+{
+  SimTransmission_t *pTx = calloc(1, sizeof(SimTransmission_t));
+  uint32_t bits;
+
+  if (pTx == NULL)
+  {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  pTx->pSender = pSender;
+  pTx->start = ns;
+  pTx->channel = pSender->reg[REG_RF_CH];
+  pTx->rate2M = (pSender->reg[REG_RF_SETUP] & RF_SETUP_DR) != 0;
+  pTx->aw = RadioAddressWidth(pSender);
+  memcpy(pTx->addr, pAddr, MAX_ADDR);
+  pTx->crc = RadioCrc(pSender);
+  pTx->ack = ack;
+  pTx->noAck = pPayload->noAck;
+  pTx->pid = pSender->pid;
+  pTx->ackPipe = ack ? pPayload->pipe : PIPE_NONE;
+  pTx->len = pPayload->len;
+  memcpy(pTx->data, pPayload->data, pPayload->len);
+  pTx->dbm = RadioDbm(pSender);
+
+  bits = 8 + 8 * pTx->aw + 9 + 8 * pTx->len + 8 * pTx->crc;
+  pTx->end = ns + (int64_t)bits * (pTx->rate2M ? 500 : 1000);
+
+  pTx->pNext = pAirList;
+  pAirList = pTx;
+  if (!ack)
+  {
+    pSender->stats.sent++;
+    pSender->stats.dbmSum += pTx->dbm;
+  }
+  SimSchedule(pTx->end, AirEnd, pTx, 0);
+  return pTx;
+}
+
+/*!
+ \brief Transmission over, mark collisions and hand it to every receiver
+ */
+static void AirEnd(void *pArg, uint32_t tag)
+{
+  SimTransmission_t *pTx = pArg;
+  SimTransmission_t *pOther;
+  SimTransmission_t **ppLink;
+  SimRadio_t *pSender = pTx->pSender;
+  uint8_t i;
+
+  (void)tag;
+  for (pOther = pAirList; pOther != NULL; pOther = pOther->pNext)
+  {
+    if ((pOther != pTx) && (pOther->channel == pTx->channel) &&
+        (pOther->start < pTx->end) && (pOther->end > pTx->start) && !pOther->aborted)
+    {
+      pTx->collided = true;
+      pOther->collided = true;
+    }
+  }
+  if (pTx->collided && !pTx->ack)
+    pSender->stats.collided++;
+
+  if (!pTx->aborted)
+  {
+    for (i = 0; i < simNumNodes; i++)
+      RadioReceive(simNodes[i]->pRadio, pTx, simNow);
+    if (pSender->pAir == pTx)
+      RadioTxDone(pSender, pTx, simNow);
+  }
+
+  /* ended long enough ago that nothing still on the air overlaps */
+  ppLink = &pAirList;
+  while (*ppLink != NULL)
+  {
+    pOther = *ppLink;
+    if ((pOther->end < simNow - T_AIR_KEEP) && (pOther != pTx))
+    {
+      *ppLink = pOther->pNext;
+      free(pOther);
+    }
+    else
+      ppLink = &pOther->pNext;
+  }
+}
+
+/*!
+ \brief Link margin, random loss and WLAN bursts for one reception
+
+ Packet error rises smoothly through the sensitivity, 50% at 0dB margin.
+ */
+static bool AirLinkOk(const SimTransmission_t *pTx, const SimRadio_t *pReceiver)
+{
+  double margin = pTx->dbm - AirPathLoss(pTx->pSender, pReceiver) -
+                  (pTx->rate2M ? SENSITIVITY_2MBPS : SENSITIVITY_1MBPS);
+
+  if (SimRandom() < 1.0 / (1.0 + pow(10.0, margin / 3.0)))
+    return false;
+  if (SimRandom() < simConfig.loss)
+    return false;
+  return !AirWlan(pTx->channel);
+}
+
+static double AirPathLoss(const SimRadio_t *pA, const SimRadio_t *pB)
+{
+  return pA->pathLossDb + pB->pathLossDb;
+}
+
+static bool AirWlan(uint8_t channel)
+{
+  int offset = (int)channel - (int)simConfig.interferer;
+
+  if ((simConfig.interferer == 0) || (simNow < simConfig.interfererNs) ||
+      (offset < -WLAN_HALF_WIDTH) || (offset > WLAN_HALF_WIDTH))
+    return false;
+  return SimRandom() < simConfig.interfererDuty;
+}
@@ -0,0 +1,642 @@
+/*! \file sim.c
+    \brief Scheduler, command line and report of the network simulator
+
+ Usage: childtracker-sim [options]
+   -n children      children watched, 1..63 (5)
+   -t seconds       simulated time (120)
+   -l loss          random loss per reception, 0..1 (0)
+   -s seed          random seed (1)
+   -d ppm           DCO spread between nodes, +/- (2000)
+   -p dB            path loss child to Parent (60)
+   -P dB            extra path loss per child, uniform 0..dB (10)
+   -w ch:duty[@s]   WLAN centred on nRF channel ch, busy duty 0..1, from s
+   -k child@second  child stops, repeatable
+   -f child@second  child runs a fever, repeatable
+   -v child@second  child's cell drops to 2.2V, repeatable
+   -c name          a build configuration, children run child-<name>.so
+                    and the Parent parent<n>-<name>.so
+   -b mAh           battery capacity for the energy report (225, CR2032)
+
+ The Parent watches min(children, PROTOCOL_MAX_CHILDREN), children
+ beyond that have no pipe and stay off the air. Alarms are decoded
+ from the Parent piezo: a group of child + 1 beeps, one group for a
+ fever, two for a lost child, three for a low battery.
+*/
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define SIM_QUANTUM_NS          (10 * SIM_NS_PER_US)
+#define SIM_MAX_CHILDREN        (SIM_MAX_NODES - 1)
+#define SIM_PARENT_PIPES        (6)       /* PROTOCOL_MAX_CHILDREN */
+#define SIM_MAX_SCENARIO        (32)
+
+#define SIM_TEMPERATURE         (36.0)    /* degrees C */
+#define SIM_FEVER               (39.0)
+#define SIM_VCC                 (3.0)     /* fresh CR2032 */
+#define SIM_VCC_LOW             (2.2)
+#define SIM_BOOT_SPREAD_NS      (SIM_NS_PER_S)
+
+/* Parent Alarm(), a beep is ~130ms, 65ms apart in a group, 196ms between groups */
+#define SIM_BEEP_GAP_NS         (100 * SIM_NS_PER_MS)
+#define SIM_GROUP_GAP_NS        (300 * SIM_NS_PER_MS)
+#define SIM_STARTUP_NS          (2 * SIM_NS_PER_S)
+
+typedef struct
+{
+  int64_t ns;
+  uint64_t seq;
+  void (*pFunc)(void *, uint32_t);
+  void *pArg;
+  uint32_t tag;
+} SimEvent_t;
+
+typedef struct
+{
+  int64_t start;
+  int64_t end;
+  uint8_t size;
+} SimGroup_t;
+
+SimConfig_t simConfig =
+{
+  5, 120 * SIM_NS_PER_S, 0.0, 2000.0, 60.0, 10.0, 0, 0.0, 0, 1, NULL, 225.0
+};
+SimNode_t *simNodes[SIM_MAX_NODES];
+uint8_t simNumNodes = 0;
+SimNode_t *pSimCurrent = NULL;
+int64_t simNow = 0;
+
+static SimEvent_t *pEvents = NULL;
+static size_t numEvents = 0;
+static size_t maxEvents = 0;
+static uint64_t eventSeq = 0;
+static uint64_t randomState;
+
+static void SimUsage(const char *pName);
+static bool SimParseScenario(const char *pArg, uint8_t *pChild, int64_t *pNs);
+static bool SimCheckChildren(const uint8_t *pChildren, uint8_t num);
+static void SimKill(void *pArg, uint32_t tag);
+static void SimFever(void *pArg, uint32_t tag);
+static void SimLowBattery(void *pArg, uint32_t tag);
+static void *SimLoad(const char *pDir, const char *pTmp, const char *pImage, uint8_t index);
+static void SimRun(void);
+static void SimReport(void);
+static uint16_t SimDecodeGroups(const SimNode_t *pParent, SimGroup_t *pGroups, uint16_t maxGroups);
+static uint16_t SimGroupRun(const SimGroup_t *pGroups, uint16_t numGroups, uint16_t first);
+static void SimReportAlarm(const char *pWhat, const SimNode_t *pNode, int64_t ns,
+                           const SimGroup_t *pGroups, uint16_t numGroups, uint16_t run);
+
+int main(int argc, char **argv)
+{
+  char dir[PATH_MAX];
+  char tmp[] = "/tmp/childtracker-simXXXXXX";
+  char image[32];
+  char *pSlash;
+  ssize_t len;
+  int opt;
+  int children;
+  uint8_t i;
+  uint8_t child;
+  uint8_t watched;
+  int64_t ns;
+  double interfererS;
+  uint8_t numKills = 0;
+  uint8_t numFevers = 0;
+  uint8_t numLows = 0;
+  uint8_t kills[SIM_MAX_SCENARIO];
+  uint8_t fevers[SIM_MAX_SCENARIO];
+  uint8_t lows[SIM_MAX_SCENARIO];
+  int64_t killNs[SIM_MAX_SCENARIO];
+  int64_t feverNs[SIM_MAX_SCENARIO];
+  int64_t lowNs[SIM_MAX_SCENARIO];
+  SimNode_t *pNode;
+
+  while ((opt = getopt(argc, argv, "n:t:l:s:d:p:P:w:k:f:v:c:b:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      children = atoi(optarg);
+      if ((children < 1) || (children > SIM_MAX_CHILDREN))
+        SimUsage(argv[0]);
+      simConfig.numChildren = (uint8_t)children;
+      break;
+    case 't':
+      simConfig.endNs = (int64_t)(atof(optarg) * SIM_NS_PER_S);
+      break;
+    case 'l':
+      simConfig.loss = atof(optarg);
+      break;
+    case 's':
+      simConfig.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'd':
+      simConfig.driftPpm = atof(optarg);
+      break;
+    case 'p':
+      simConfig.pathLossDb = atof(optarg);
+      break;
+    case 'P':
+      simConfig.pathSpreadDb = atof(optarg);
+      break;
+    case 'w':
+      interfererS = 0;
+      if (sscanf(optarg, "%hhu:%lf@%lf", &simConfig.interferer, &simConfig.interfererDuty,
+                 &interfererS) < 2)
+        SimUsage(argv[0]);
+      simConfig.interfererNs = (int64_t)(interfererS * SIM_NS_PER_S);
+      break;
+    case 'k':
+      if ((numKills == SIM_MAX_SCENARIO) || !SimParseScenario(optarg, &child, &ns))
+        SimUsage(argv[0]);
+      kills[numKills] = child;
+      killNs[numKills++] = ns;
+      break;
+    case 'f':
+      if ((numFevers == SIM_MAX_SCENARIO) || !SimParseScenario(optarg, &child, &ns))
+        SimUsage(argv[0]);
+      fevers[numFevers] = child;
+      feverNs[numFevers++] = ns;
+      break;
+    case 'v':
+      if ((numLows == SIM_MAX_SCENARIO) || !SimParseScenario(optarg, &child, &ns))
+        SimUsage(argv[0]);
+      lows[numLows] = child;
+      lowNs[numLows++] = ns;
+      break;
+    case 'c':
+      simConfig.pChildImage = optarg;
+      break;
+    case 'b':
+      simConfig.batteryMah = atof(optarg);
+      break;
+    default:
+      SimUsage(argv[0]);
+      break;
+    }
+  }
+  if ((simConfig.endNs < 0) || (simConfig.loss < 0.0) || (simConfig.loss > 1.0) ||
+      !SimCheckChildren(kills, numKills) || !SimCheckChildren(fevers, numFevers) ||
+      !SimCheckChildren(lows, numLows))
+    SimUsage(argv[0]);
+  randomState = simConfig.seed ? simConfig.seed : 1;
+
+  /* firmware images live next to the executable */
+  len = readlink("/proc/self/exe", dir, sizeof(dir) - 1);
+  if (len < 0)
+  {
+    perror("readlink");
+    return EXIT_FAILURE;
+  }
+  dir[len] = '\0';
+  pSlash = strrchr(dir, '/');
+  if (pSlash != NULL)
+    *pSlash = '\0';
+  if (mkdtemp(tmp) == NULL)
+  {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+
+  simNumNodes = simConfig.numChildren + 1;
+  for (i = 0; i < simNumNodes; i++)
+  {
+    pNode = calloc(1, sizeof(SimNode_t));
+    if (pNode == NULL)
+    {
+      perror("calloc");
+      return EXIT_FAILURE;
+    }
+    pNode->index = i;
+    pNode->isParent = (i == 0);
+    pNode->childId = i ? i - 1 : 0;
+    if (pNode->isParent)
+    {
+      watched = (simConfig.numChildren < SIM_PARENT_PIPES) ? simConfig.numChildren : SIM_PARENT_PIPES;
+      if (simConfig.pChildImage != NULL)
+        snprintf(image, sizeof(image), "parent%u-%s.so", watched, simConfig.pChildImage);
+      else
+        snprintf(image, sizeof(image), "parent%u.so", watched);
+    }
+    else if (simConfig.pChildImage != NULL)
+      snprintf(image, sizeof(image), "child-%s.so", simConfig.pChildImage);
+    else
+      snprintf(image, sizeof(image), "child.so");
+    pNode->pHandle = SimLoad(dir, tmp, image, i);
+    pNode->pMain = (void (*)(void))dlsym(pNode->pHandle, "SimFirmwareMain");
+    pNode->pVectors = dlsym(pNode->pHandle, "simVectors");
+    pNode->pEnergyTicks = dlsym(pNode->pHandle, "energyTicks");
+    pNode->pProbes = dlsym(pNode->pHandle, "probes");
+    if ((pNode->pMain == NULL) || (pNode->pVectors == NULL) || (pNode->pEnergyTicks == NULL) ||
+        (pNode->pProbes == NULL))
+    {
+      fprintf(stderr, "%s: %s\n", image, dlerror());
+      return EXIT_FAILURE;
+    }
+
+    pNode->bootNs = pNode->isParent ? 0 : (int64_t)(SimRandom() * SIM_BOOT_SPREAD_NS);
+    pNode->nsPerCycle = 1000.0 / (1.0 + (2.0 * SimRandom() - 1.0) * simConfig.driftPpm * 1e-6);
+    pNode->temperature = SIM_TEMPERATURE;
+    pNode->vcc = SIM_VCC;
+    pNode->killNs = SIM_NEVER;
+    pNode->feverNs = SIM_NEVER;
+    pNode->lowNs = SIM_NEVER;
+    pNode->pRadio = SimRadioCreate(pNode, pNode->isParent ? 0.0 :
+                                   simConfig.pathLossDb + SimRandom() * simConfig.pathSpreadDb);
+    SimNodeInit(pNode);
+    SimNodeStart(pNode);
+    simNodes[i] = pNode;
+  }
+  rmdir(tmp);
+
+  for (i = 0; i < numKills; i++)
+  {
+    simNodes[kills[i] + 1]->killNs = killNs[i];
+    SimSchedule(killNs[i], SimKill, simNodes[kills[i] + 1], 0);
+  }
+  for (i = 0; i < numFevers; i++)
+  {
+    simNodes[fevers[i] + 1]->feverNs = feverNs[i];
+    SimSchedule(feverNs[i], SimFever, simNodes[fevers[i] + 1], 0);
+  }
+  for (i = 0; i < numLows; i++)
+  {
+    simNodes[lows[i] + 1]->lowNs = lowNs[i];
+    SimSchedule(lowNs[i], SimLowBattery, simNodes[lows[i] + 1], 0);
+  }
+
+  SimRun();
+  SimReport();
+  SimEnergyReport();
+  SimProbeReport();
+  return EXIT_SUCCESS;
+}
+
+/*!
+ \brief Queue an event, equal times run in the order they were queued
+ */
+void SimSchedule(int64_t ns, void (*pFunc)(void *, uint32_t), void *pArg, uint32_t tag)
+{
+  SimEvent_t event = { ns, eventSeq++, pFunc, pArg, tag };
+  size_t child = numEvents++;
+  size_t parent;
+
+  if (numEvents > maxEvents)
+  {
+    maxEvents = maxEvents ? maxEvents * 2 : 256;
+    pEvents = realloc(pEvents, maxEvents * sizeof(SimEvent_t));
+    if (pEvents == NULL)
+    {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+  }
+  while (child > 0)
+  {
+    parent = (child - 1) / 2;
+    if ((pEvents[parent].ns < ns) || ((pEvents[parent].ns == ns) && (pEvents[parent].seq < event.seq)))
+      break;
+    pEvents[child] = pEvents[parent];
+    child = parent;
+  }
+  pEvents[child] = event;
+
+  /* the running node must not overtake what it just started */
+  if ((pSimCurrent != NULL) && (ns + SIM_QUANTUM_NS < pSimCurrent->limitNs))
+    pSimCurrent->limitNs = ns + SIM_QUANTUM_NS;
+}
+
+/*!
+ \brief xorshift64*, uniform in [0, 1)
+ */
+double SimRandom(void)
+{
+  randomState ^= randomState >> 12;
+  randomState ^= randomState << 25;
+  randomState ^= randomState >> 27;
+  return (double)((randomState * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static void SimUsage(const char *pName)
+{
+  fprintf(stderr,
+          "usage: %s [-n children] [-t seconds] [-l loss] [-s seed] [-d ppm]\n"
+          "       [-p dB] [-P dB] [-w channel:duty[@second]] [-k child@second] [-f child@second]\n"
+          "       [-v child@second] [-c name] [-b mAh]\n",
+          pName);
+  exit(EXIT_FAILURE);
+}
+
+static bool SimParseScenario(const char *pArg, uint8_t *pChild, int64_t *pNs)
+{
+  unsigned child;
+  double seconds;
+
+  if ((sscanf(pArg, "%u@%lf", &child, &seconds) != 2) || (child > UINT8_MAX) || (seconds < 0.0))
+    return false;
+  *pChild = (uint8_t)child;
+  *pNs = (int64_t)(seconds * SIM_NS_PER_S);
+  return true;
+}
+
+/* every child a scenario names must be simulated, -n may come after it */
+static bool SimCheckChildren(const uint8_t *pChildren, uint8_t num)
+{
+  uint8_t i;
+
+  for (i = 0; i < num; i++)
+  {
+    if (pChildren[i] >= simConfig.numChildren)
+      return false;
+  }
+  return true;
+}
+
+static void SimKill(void *pArg, uint32_t tag)
+{
+  SimNode_t *pNode = pArg;
+
+  (void)tag;
+  pNode->state = SIM_NODE_DEAD;
+  SimRadioKill(pNode->pRadio, simNow);
+}
+
+static void SimFever(void *pArg, uint32_t tag)
+{
+  (void)tag;
+  ((SimNode_t *)pArg)->temperature = SIM_FEVER;
+}
+
+static void SimLowBattery(void *pArg, uint32_t tag)
+{
+  (void)tag;
+  ((SimNode_t *)pArg)->vcc = SIM_VCC_LOW;
+}
+
+/*!
+ \brief dlopen a private copy of a firmware image, one per node
+
+ Each copy has its own statics; the simulator's register and intrinsic
+ functions resolve against the executable.
+ */
+static void *SimLoad(const char *pDir, const char *pTmp, const char *pImage, uint8_t index)
+{
+  char src[PATH_MAX];
+  char dst[PATH_MAX];
+  char buf[65536];
+  FILE *pIn;
+  FILE *pOut;
+  size_t len;
+  void *pHandle;
+
+  snprintf(src, sizeof(src), "%s/%s", pDir, pImage);
+  snprintf(dst, sizeof(dst), "%s/node%u.so", pTmp, index);
+  pIn = fopen(src, "rb");
+  if (pIn == NULL)
+  {
+    perror(src);
+    exit(EXIT_FAILURE);
+  }
+  pOut = fopen(dst, "wb");
+  if (pOut == NULL)
+  {
+    perror(dst);
+    exit(EXIT_FAILURE);
+  }
+  while ((len = fread(buf, 1, sizeof(buf), pIn)) > 0)
+    fwrite(buf, 1, len, pOut);
+  fclose(pIn);
+  fclose(pOut);
+
+  pHandle = dlopen(dst, RTLD_NOW | RTLD_LOCAL);
+  unlink(dst);
+  if (pHandle == NULL)
+  {
+    fprintf(stderr, "%s\n", dlerror());
+    exit(EXIT_FAILURE);
+  }
+  return pHandle;
+}
+
+/*!
+ \brief Always advance whatever is furthest behind
+
+ A node runs until it sleeps or gets one quantum past the next event or
+ the next node, so interactions are at most a quantum late.
+ */
+static void SimRun(void)
+{
+  SimNode_t *pBest;
+  int64_t bestNs;
+  int64_t secondNs;
+  int64_t eventNs;
+  int64_t ns;
+  SimEvent_t event;
+  size_t parent;
+  size_t child;
+  uint8_t i;
+
+  while (1)
+  {
+    pBest = NULL;
+    bestNs = SIM_NEVER;
+    secondNs = SIM_NEVER;
+    for (i = 0; i < simNumNodes; i++)
+    {
+      if (simNodes[i]->state == SIM_NODE_DEAD)
+        continue;
+      ns = (simNodes[i]->state == SIM_NODE_RUNNING) ? SimNodeNs(simNodes[i]) : simNodes[i]->wakeNs;
+      if (ns < bestNs)
+      {
+        secondNs = bestNs;
+        bestNs = ns;
+        pBest = simNodes[i];
+      }
+      else if (ns < secondNs)
+        secondNs = ns;
+    }
+    eventNs = numEvents ? pEvents[0].ns : SIM_NEVER;
+
+    if (eventNs <= bestNs)
+    {
+      if (eventNs >= simConfig.endNs)
+        break;
+      event = pEvents[0];
+      numEvents--;
+      parent = 0;
+      while ((child = 2 * parent + 1) < numEvents)
+      {
+        if ((child + 1 < numEvents) &&
+            ((pEvents[child + 1].ns < pEvents[child].ns) ||
+             ((pEvents[child + 1].ns == pEvents[child].ns) && (pEvents[child + 1].seq < pEvents[child].seq))))
+          child++;
+        if ((pEvents[numEvents].ns < pEvents[child].ns) ||
+            ((pEvents[numEvents].ns == pEvents[child].ns) && (pEvents[numEvents].seq < pEvents[child].seq)))
+          break;
+        pEvents[parent] = pEvents[child];
+        parent = child;
+      }
+      pEvents[parent] = pEvents[numEvents];
+      if (event.ns > simNow)
+        simNow = event.ns;
+      event.pFunc(event.pArg, event.tag);
+      continue;
+    }
+
+    if (bestNs >= simConfig.endNs)
+      break;
+    if (bestNs > simNow)
+      simNow = bestNs;
+    SimNodeResume(pBest, ((eventNs < secondNs) ? eventNs : secondNs) + SIM_QUANTUM_NS);
+  }
+  simNow = simConfig.endNs;
+}
+
+/*!
+ \brief Per-child delivery, air collisions and alarm latency
+ */
+static void SimReport(void)
+{
+  static SimGroup_t groups[SIM_MAX_BEEPS];
+  const SimRadioStats_t *pStats;
+  const SimNode_t *pNode;
+  uint32_t sent = 0;
+  uint32_t collided = 0;
+  uint32_t queued = 0;
+  uint32_t delivered = 0;
+  uint16_t numGroups;
+  uint16_t g;
+  uint8_t watched = (simConfig.numChildren < SIM_PARENT_PIPES) ? simConfig.numChildren : SIM_PARENT_PIPES;
+  uint8_t i;
+  uint32_t falseAlarms = 0;
+  uint16_t run;
+
+  printf("children %u (Parent watches %u), %.0f s, loss %.3f, drift %.0f ppm, "
+         "path %.0f+%.0f dB, seed %llu\n",
+         simConfig.numChildren, watched, (double)simConfig.endNs / SIM_NS_PER_S, simConfig.loss,
+         simConfig.driftPpm, simConfig.pathLossDb, simConfig.pathSpreadDb,
+         (unsigned long long)simConfig.seed);
+  if (simConfig.interferer)
+    printf("WLAN on channel %u, duty %.2f, from %.0f s\n", simConfig.interferer,
+           simConfig.interfererDuty, (double)simConfig.interfererNs / SIM_NS_PER_S);
+
+  printf("\nchild  reports  delivered   rate   sent  retries  failed  collided  avg dBm\n");
+  for (i = 1; i < simNumNodes; i++)
+  {
+    pNode = simNodes[i];
+    pStats = SimRadioGetStats(pNode->pRadio);
+    printf("%5u  %7u  %9u  %5.1f%%  %5u  %7u  %6u  %8u  %7.1f%s\n",
+           pNode->childId, pStats->queued, pStats->delivered,
+           pStats->queued ? 100.0 * pStats->delivered / pStats->queued : 0.0,
+           pStats->sent, pStats->sent - pStats->packets, pStats->failed, pStats->collided,
+           pStats->sent ? pStats->dbmSum / pStats->sent : 0.0,
+           (pNode->childId >= watched) ? "  no Parent pipe" : "");
+    sent += pStats->sent;
+    collided += pStats->collided;
+    if (pNode->childId < watched)
+    {
+      queued += pStats->queued;
+      delivered += pStats->delivered;
+    }
+  }
+  printf("\ndelivery %u/%u (%.1f%%), collisions %u/%u transmissions (%.2f%%)\n",
+         delivered, queued, queued ? 100.0 * delivered / queued : 0.0,
+         collided, sent, sent ? 100.0 * collided / sent : 0.0);
+
+  /* alarms heard from the Parent */
+  numGroups = SimDecodeGroups(simNodes[0], groups, SIM_MAX_BEEPS);
+  printf("\nalarms\n");
+  for (i = 1; i < simNumNodes; i++)
+  {
+    pNode = simNodes[i];
+    if (pNode->childId >= watched)
+      continue;
+    for (g = 0; g < numGroups; g += run)
+    {
+      run = SimGroupRun(groups, numGroups, g);
+      if ((groups[g].size == pNode->childId + 1) && (run == 2) &&
+          (groups[g].start < pNode->killNs) && (groups[g].start < pNode->feverNs))
+        falseAlarms++;
+    }
+    SimReportAlarm("lost", pNode, pNode->killNs, groups, numGroups, 2);
+    SimReportAlarm("fever", pNode, pNode->feverNs, groups, numGroups, 0);
+    SimReportAlarm("battery low", pNode, pNode->lowNs, groups, numGroups, 3);
+  }
+  printf("  false lost-child alarms %u\n", falseAlarms);
+}
+
+/*!
+ \brief First alarm of run groups for the child after ns, if it happened
+
+ Fever alarms repeat with every report and may run together, run 0
+ takes any.
+ */
+static void SimReportAlarm(const char *pWhat, const SimNode_t *pNode, int64_t ns,
+                           const SimGroup_t *pGroups, uint16_t numGroups, uint16_t run)
+{
+  uint16_t g;
+  uint16_t length;
+
+  if (ns == SIM_NEVER)
+    return;
+  for (g = 0; g < numGroups; g += length)
+  {
+    length = SimGroupRun(pGroups, numGroups, g);
+    if ((pGroups[g].size == pNode->childId + 1) && (pGroups[g].start > ns) && ((run == 0) || (length == run)))
+    {
+      printf("  child %u %s at %.1f s, alarm after %.2f s\n", pNode->childId, pWhat,
+             (double)ns / SIM_NS_PER_S, (double)(pGroups[g].start - ns) / SIM_NS_PER_S);
+      return;
+    }
+  }
+  printf("  child %u %s at %.1f s, no alarm\n", pNode->childId, pWhat, (double)ns / SIM_NS_PER_S);
+}
+
+/*!
+ \brief Groups of the same size in a row from first, one alarm
+ */
+static uint16_t SimGroupRun(const SimGroup_t *pGroups, uint16_t numGroups, uint16_t first)
+{
+  uint16_t g = first + 1;
+
+  while ((g < numGroups) && (pGroups[g].size == pGroups[first].size) &&
+         (pGroups[g].start - pGroups[g - 1].end < SIM_GROUP_GAP_NS))
+    g++;
+  return g - first;
+}
+
+/*!
+ \brief Group the Parent beeps, the power-up beeps are skipped
+ */
+static uint16_t SimDecodeGroups(const SimNode_t *pParent, SimGroup_t *pGroups, uint16_t maxGroups)
+{
+  uint16_t numGroups = 0;
+  uint16_t b;
+
+  for (b = 0; b < pParent->numBeeps; b++)
+  {
+    if (pParent->beeps[b].start < SIM_STARTUP_NS)
+      continue;
+    if ((numGroups > 0) && (pParent->beeps[b].start - pGroups[numGroups - 1].end < SIM_BEEP_GAP_NS))
+    {
+      pGroups[numGroups - 1].end = pParent->beeps[b].end;
+      pGroups[numGroups - 1].size++;
+      continue;
+    }
+    if (numGroups == maxGroups)
+      break;
+    pGroups[numGroups].start = pParent->beeps[b].start;
+    pGroups[numGroups].end = pParent->beeps[b].end;
+    pGroups[numGroups].size = 1;
+    numGroups++;
+  }
+  return numGroups;
+}
@@ -0,0 +1,181 @@
+/*! \file sim.h
+    \brief Host simulator of the ChildTracker network, shared declarations
+
+ Each node runs its firmware, unmodified, in a coroutine against a
+ modelled MSP430F20x2 (mcu.c) and nRF24L01 (radio.c). Time is kept in
+ nanoseconds by a discrete event scheduler (sim.c) which always resumes
+ the node or event furthest behind.
+*/
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+#include "io430x20x2.h"
+
+#define SIM_NS_PER_US           (1000LL)
+#define SIM_NS_PER_MS           (1000000LL)
+#define SIM_NS_PER_S            (1000000000LL)
+#define SIM_NEVER               (INT64_MAX)
+
+#define SIM_MAX_NODES           (64)
+#define SIM_MAX_BEEPS           (4096)
+#define SIM_PROBE_MAX           (4)       /* PROBE_MAX */
+
+typedef struct SimRadio SimRadio_t;
+typedef struct SimTransmission SimTransmission_t;
+
+typedef struct
+{
+  uint32_t queued;                  /* payloads loaded into the TX FIFO */
+  uint32_t packets;                 /* first transmissions */
+  uint32_t sent;                    /* transmissions, retransmits included */
+  uint32_t acked;
+  uint32_t failed;                  /* MAX_RT */
+  uint32_t collided;                /* overlapped another on the channel */
+  uint32_t delivered;               /* new packets taken by a receiver */
+  double dbmSum;                    /* TX power over sent */
+} SimRadioStats_t;
+
+/* Probe_t as built for the host, u32_t is unsigned long there */
+typedef struct
+{
+  unsigned long count;
+  unsigned long total;
+  unsigned short min;
+  unsigned short max;
+} SimProbe_t;
+
+typedef struct
+{
+  unsigned short vector;
+  void (*pHandler)(void);
+} SimVector_t;
+
+typedef enum
+{
+  SIM_NODE_RUNNING,
+  SIM_NODE_SLEEPING,
+  SIM_NODE_DEAD
+} SimNodeState_t;
+
+typedef struct
+{
+  int64_t start;
+  int64_t end;
+} SimBeep_t;
+
+typedef struct
+{
+  /* identity, the Parent is node 0, child n is node n + 1 */
+  uint8_t index;
+  bool isParent;
+  uint8_t childId;
+
+  /* firmware image, a private copy of the shared object */
+  void *pHandle;
+  void (*pMain)(void);
+  const SimVector_t *pVectors;
+
+  /* coroutine */
+  ucontext_t context;
+  void *pStack;
+  SimNodeState_t state;
+  int64_t wakeNs;
+  int64_t limitNs;
+
+  /* MCLK = SMCLK = DCO, counted from power-up */
+  int64_t bootNs;
+  double nsPerCycle;
+  uint64_t cycles;
+
+  /* CPU */
+  uint16_t sr;
+  uint16_t srStack[8];
+  uint8_t srDepth;
+  uint16_t reg[SIM_REG_MAX];
+  uint16_t seen[SIM_REG_MAX];       /* as of the last sync, to spot writes */
+
+  /* peripherals */
+  uint64_t timerBase;               /* cycles >> ID at TACLR */
+  uint64_t timerTicks;
+  bool usiBusy;
+  uint64_t usiDone;
+  bool adcBusy;                     /* converting */
+  uint64_t adcDone;
+  bool adcRunning;                  /* in a sequence */
+  uint16_t adcChannel;
+  uint8_t adcDtcIndex;
+  bool irqLine;                     /* nRF24L01 IRQ pin, high when idle */
+  bool irqSeen;
+  SimRadio_t *pRadio;
+
+  /* energyTicks[] in the image, u32_t is unsigned long there */
+  const volatile unsigned long *pEnergyTicks;
+  const SimProbe_t *pProbes;        /* also locates the image's data for the DTC */
+
+  /* environment */
+  double temperature;               /* degrees C at the sensor */
+  double vcc;                       /* cell voltage */
+  int64_t killNs;
+  int64_t feverNs;
+  int64_t lowNs;
+
+  /* piezo, beeps are toggle bursts separated by silence */
+  SimBeep_t beeps[SIM_MAX_BEEPS];
+  uint16_t numBeeps;
+  int64_t lastToggleNs;
+} SimNode_t;
+
+typedef struct
+{
+  uint8_t numChildren;
+  int64_t endNs;
+  double loss;                      /* random loss per reception, 0..1 */
+  double driftPpm;                  /* DCO spread, uniform +/- */
+  double pathLossDb;                /* child to Parent */
+  double pathSpreadDb;              /* extra per child, uniform 0..spread */
+  uint8_t interferer;               /* WLAN centre, nRF channel, 0 none */
+  double interfererDuty;
+  int64_t interfererNs;             /* switched on at */
+  uint64_t seed;
+  const char *pChildImage;          /* child-<name>.so, child.so when NULL */
+  double batteryMah;
+} SimConfig_t;
+
+extern SimConfig_t simConfig;
+extern SimNode_t *simNodes[SIM_MAX_NODES];
+extern uint8_t simNumNodes;
+extern SimNode_t *pSimCurrent;
+extern int64_t simNow;
+
+/* sim.c */
+void SimSchedule(int64_t ns, void (*pFunc)(void *, uint32_t), void *pArg, uint32_t tag);
+double SimRandom(void);
+
+/* mcu.c */
+void SimNodeInit(SimNode_t *pNode);
+void SimNodeStart(SimNode_t *pNode);
+void SimNodeResume(SimNode_t *pNode, int64_t limitNs);
+int64_t SimNodeNs(const SimNode_t *pNode);
+void SimNodeIrq(SimNode_t *pNode, bool level);
+
+/* radio.c */
+SimRadio_t *SimRadioCreate(SimNode_t *pNode, double pathLossDb);
+void SimRadioSetCsn(SimRadio_t *pRadio, bool level, int64_t ns);
+void SimRadioSetCe(SimRadio_t *pRadio, bool level, int64_t ns);
+uint8_t SimRadioSpi(SimRadio_t *pRadio, uint8_t mosi, int64_t ns);
+void SimRadioKill(SimRadio_t *pRadio, int64_t ns);
+const SimRadioStats_t *SimRadioGetStats(const SimRadio_t *pRadio);
+uint8_t SimRadioGetRfSetup(const SimRadio_t *pRadio);
+
+/* energy.c */
+void SimEnergyReport(void);
+
+/* probe.c */
+void SimProbeReport(void);
+
+#endif
@@ -0,0 +1,42 @@
+# Interrupt vector table for the simulator, from the IAR
+#   #pragma vector = X
+#   __interrupt void Handler(void)
+# pairs in the firmware sources.
+
+/^[ \t]*#pragma[ \t]+vector[ \t]*=/ {
+  vector = $0
+  sub(/^[^=]*=[ \t]*/, "", vector)
+  sub(/[ \t\r]*$/, "", vector)
+  next
+}
+
+vector != "" && /__interrupt/ {
+  handler = $0
+  sub(/^.*void[ \t]+/, "", handler)
+  sub(/[ \t]*\(.*$/, "", handler)
+  vectors[n + 0] = vector
+  handlers[n + 0] = handler
+  n++
+  vector = ""
+}
+
+END {
+  print "/* generated by vectors.awk */"
+  print "#include \"io430x20x2.h\""
+  print ""
+  print "typedef struct"
+  print "{"
+  print "  unsigned short vector;"
+  print "  void (*pHandler)(void);"
+  print "} SimVector_t;"
+  print ""
+  for (i = 0; i < n; i++)
+    print "void " handlers[i] "(void);"
+  print ""
+  print "const SimVector_t simVectors[] ="
+  print "{"
+  for (i = 0; i < n; i++)
+    print "  { " vectors[i] ", " handlers[i] " },"
+  print "  { 0, 0 }"
+  print "};"
+}